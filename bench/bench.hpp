@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+/**
+ * @brief Command line options of the benchmarks
+ */
+struct options {
+  double min_time = 0.1; ///< Minimal measurement time in seconds
+  std::vector<std::string> filters;
+
+  bool selected(std::string_view name) const {
+    if (filters.empty())
+      return true;
+    return std::any_of(filters.begin(), filters.end(),
+                       [name](auto const &filter) {
+                         return name.find(filter) != std::string_view::npos;
+                       });
+  }
+};
+
+/**
+ * @brief Measure the time of the tick in nanoseconds.
+ * The number of ticks per sample is doubled until the sample takes a fifth of
+ * the minimal time, the median of five samples is returned.
+ */
+template <typename Tick> double ns_per_tick(options const &opts, Tick &&tick) {
+  using clock = std::chrono::steady_clock;
+
+  // The nodes allocate their state on the first ticks
+  for (int i = 0; i < 1000; ++i)
+    tick();
+
+  size_t iterations = 1000;
+  std::vector<double> samples;
+  while (samples.size() < 5) {
+    auto const start = clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+      tick();
+    std::chrono::duration<double> const elapsed = clock::now() - start;
+
+    if (elapsed.count() < opts.min_time / 5) {
+      iterations *= 2;
+      continue;
+    }
+    samples.push_back(elapsed.count() * 1e9 / iterations);
+  }
+
+  std::nth_element(samples.begin(), samples.begin() + 2, samples.end());
+  return samples[2];
+}
+
+/**
+ * @brief Options of the multi-instance scaling benchmark
+ */
+struct scaling_options : options {
+  std::vector<size_t> instances = {1000, 100000};
+  std::vector<size_t> threads = {1};
+  size_t frames = 100;
+};
+
+void tick_suite(options const &opts);
+void scaling_suite(scaling_options const &opts);
+
+} // namespace bench
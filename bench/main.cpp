@@ -0,0 +1,74 @@
+#include "bench.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+void usage() {
+  std::cout
+      << "Usage: bhvtree-bench [--min-time=<seconds>] [filter...]\n"
+         "       bhvtree-bench scaling [--instances=<n,...>] "
+         "[--threads=<n,...>] [--frames=<n>] [shape...]\n"
+         "The first form measures the tick time of the benchmarks which names "
+         "contain any of the filters.\n"
+         "The scaling form ticks many tree instances for the frames on the "
+         "threads, the shapes are 'agent' and 'crowd'.\n";
+}
+
+std::vector<size_t> numbers(char const *list) {
+  std::vector<size_t> result;
+  for (char *end = nullptr;; list = end + 1) {
+    result.push_back(std::strtoull(list, &end, 10));
+    if (*end != ',')
+      break;
+  }
+  return result;
+}
+
+bool option(char const *arg, char const *name, char const *&value) {
+  size_t const size = std::strlen(name);
+  if (std::strncmp(arg, name, size) || arg[size] != '=')
+    return false;
+  value = arg + size + 1;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool const scaling = argc > 1 && !std::strcmp(argv[1], "scaling");
+
+  bench::scaling_options opts;
+  opts.threads = {1, std::max(1u, std::thread::hardware_concurrency())};
+  if (opts.threads[1] == 1)
+    opts.threads.pop_back();
+
+  for (int i = scaling ? 2 : 1; i < argc; ++i) {
+    char const *value = nullptr;
+    if (!scaling && option(argv[i], "--min-time", value)) {
+      opts.min_time = std::atof(value);
+    } else if (scaling && option(argv[i], "--instances", value)) {
+      opts.instances = numbers(value);
+    } else if (scaling && option(argv[i], "--threads", value)) {
+      opts.threads = numbers(value);
+    } else if (scaling && option(argv[i], "--frames", value)) {
+      opts.frames = std::strtoull(value, nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--help")) {
+      usage();
+      return 0;
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      opts.filters.emplace_back(argv[i]);
+    }
+  }
+
+  if (scaling)
+    bench::scaling_suite(opts);
+  else
+    bench::tick_suite(opts);
+  return 0;
+}
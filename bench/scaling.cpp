@@ -0,0 +1,276 @@
+#include "bench.hpp"
+#include "counting_resource.hpp"
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <fstream>
+#include <unistd.h>
+#endif
+
+using namespace cppttl;
+
+namespace {
+
+/**
+ * @brief Per-instance data read by the leaves through the thread-local pointer,
+ * so the flat tree leaves shared by all instances see their instance
+ */
+struct agent {
+  std::uint32_t t;
+  std::uint32_t seed;
+};
+
+thread_local agent *current = nullptr;
+
+std::uint32_t agent_time() { return current->t + current->seed; }
+
+auto step(std::uint32_t period) {
+  return [period] {
+    auto const phase = agent_time() % period;
+    return phase == 0   ? bhv::status::success
+           : phase == 1 ? bhv::status::failure
+                        : bhv::status::running;
+  };
+}
+
+bhv::node::ptr make_agent() {
+  auto const enemy = [] { return agent_time() % 7 < 2; };
+
+  // clang-format off
+  return bhv::make_node<bhv::fallback>(std::move(
+    bhv::fallback("agent")
+      .add(bhv::sequence("combat")
+           .add<bhv::condition>("enemy", enemy)
+           .add<bhv::action>("attack", step(3)))
+      .add(bhv::if_("needs", bhv::condition("hungry", [] { return agent_time() % 11 == 0; }))
+           .then_<bhv::action>("eat", step(2))
+           .else_(bhv::switch_("mode", [] { return (current->t / 8 + current->seed) % 4; })
+                  .case_(0u)
+                    .handler<bhv::action>("idle", step(2))
+                  .case_(1u)
+                    .handler(bhv::sequence("patrol")
+                             .add<bhv::action>("move", step(4))
+                             .add<bhv::condition>("look", enemy))
+                  .case_(2u)
+                  .case_(3u)
+                    .handler(bhv::repeat("wander", 2).child<bhv::action>("walk", step(3)))))));
+  // clang-format on
+}
+
+bhv::node::ptr make_crowd() {
+  // clang-format off
+  return bhv::make_node<bhv::sequence>(std::move(
+    bhv::sequence("crowd")
+      .add<bhv::condition>("alive", [] { return true; })
+      .add<bhv::action>("move", step(4))));
+  // clang-format on
+}
+
+/**
+ * @brief The calling thread and the workers run the job for their parts of
+ * the instances, the frame completes when all the parts are done
+ */
+class frame_workers {
+public:
+  frame_workers(size_t threads, std::function<void(size_t)> job)
+      : _job(std::move(job)) {
+    for (size_t i = 1; i < threads; ++i)
+      _threads.emplace_back([this, i] { loop(i); });
+  }
+
+  ~frame_workers() {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      _stop = true;
+    }
+    _start.notify_all();
+    for (auto &thread : _threads)
+      thread.join();
+  }
+
+  void run_frame() {
+    {
+      std::lock_guard<std::mutex> lock(_lock);
+      ++_frame;
+      _remaining = _threads.size();
+    }
+    _start.notify_all();
+
+    _job(0);
+
+    std::unique_lock<std::mutex> lock(_lock);
+    _done.wait(lock, [this] { return _remaining == 0; });
+  }
+
+private:
+  void loop(size_t idx) {
+    size_t frame = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _start.wait(lock, [&] { return _stop || _frame != frame; });
+        if (_stop)
+          return;
+        frame = _frame;
+      }
+
+      _job(idx);
+
+      std::lock_guard<std::mutex> lock(_lock);
+      if (--_remaining == 0)
+        _done.notify_one();
+    }
+  }
+
+  std::function<void(size_t)> _job;
+  std::vector<std::thread> _threads;
+  std::mutex _lock;
+  std::condition_variable _start;
+  std::condition_variable _done;
+  size_t _frame = 0;
+  size_t _remaining = 0;
+  bool _stop = false;
+};
+
+size_t rss() {
+#ifdef __linux__
+  size_t pages = 0, resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 0;
+#endif
+}
+
+double percentile(std::vector<double> const &sorted, double q) {
+  auto const idx = static_cast<size_t>(q * static_cast<double>(sorted.size()));
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+/**
+ * @brief Tick the instances for the frames and print the results.
+ * tick(i) ticks the instance i, bytes() returns the memory used by the
+ * instances after the first frame.
+ */
+template <typename Tick, typename Bytes>
+void measure(bench::scaling_options const &opts, char const *shape,
+             char const *engine, std::vector<agent> &agents, size_t threads,
+             Bytes &&bytes, Tick &&tick) {
+  using clock = std::chrono::steady_clock;
+
+  size_t const count = agents.size();
+  frame_workers workers(threads, [&](size_t part) {
+    size_t const end = count * (part + 1) / threads;
+    for (size_t i = count * part / threads; i < end; ++i) {
+      current = &agents[i];
+      ++agents[i].t;
+      tick(i);
+    }
+  });
+
+  // The first frame allocates the state of the dynamic trees
+  workers.run_frame();
+  size_t const used = bytes();
+
+  std::vector<double> frames;
+  frames.reserve(opts.frames);
+  auto const begin = clock::now();
+  for (size_t f = 0; f < opts.frames; ++f) {
+    auto const start = clock::now();
+    workers.run_frame();
+    frames.push_back(
+        std::chrono::duration<double, std::micro>(clock::now() - start)
+            .count());
+  }
+  std::chrono::duration<double> const total = clock::now() - begin;
+
+  std::sort(frames.begin(), frames.end());
+  std::printf("%-6s %-8s %10zu %7zu %14.0f %10.1f %10.1f %10.1f %9.1f %9.1f\n",
+              shape, engine, count, threads,
+              static_cast<double>(count * opts.frames) / total.count(),
+              percentile(frames, 0.5), percentile(frames, 0.99),
+              percentile(frames, 0.999), static_cast<double>(rss()) / 1e6,
+              static_cast<double>(used) / static_cast<double>(count));
+}
+
+std::vector<agent> make_agents(size_t count) {
+  std::vector<agent> agents(count);
+  for (size_t i = 0; i < count; ++i)
+    agents[i] = {0, static_cast<std::uint32_t>(i * 2654435761u)};
+  return agents;
+}
+
+void run_dynamic(bench::scaling_options const &opts, char const *shape,
+                 bhv::node::ptr (*make)(), size_t count, size_t threads) {
+  test::counting_resource resource;
+  auto agents = make_agents(count);
+  std::vector<bhv::node::ptr> trees;
+  trees.reserve(count);
+
+  auto *const prev = bhv::set_memory_resource(&resource);
+  for (size_t i = 0; i < count; ++i)
+    trees.push_back(make());
+  bhv::set_memory_resource(prev);
+
+  // The node states are allocated from the resource on the first tick
+  measure(
+      opts, shape, "dynamic", agents, threads,
+      [&] { return resource.allocated() + count * sizeof(bhv::node::ptr); },
+      [&trees](size_t i) { (*trees[i])(); });
+}
+
+void run_flat(bench::scaling_options const &opts, char const *shape,
+              bhv::node::ptr (*make)(), size_t count, size_t threads) {
+  auto const root = make();
+  bhv::flat_tree const tree(*root);
+
+  auto agents = make_agents(count);
+  std::vector<bhv::flat_tree::state> states;
+  states.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    states.push_back(tree.make_state());
+
+  size_t const bytes =
+      count * (sizeof(bhv::flat_tree::state) +
+               states.front().capacity() * sizeof(size_t));
+
+  measure(
+      opts, shape, "flat", agents, threads, [bytes] { return bytes; },
+      [&tree, &states](size_t i) { tree(states[i]); });
+}
+
+} // namespace
+
+namespace bench {
+
+void scaling_suite(scaling_options const &opts) {
+  struct {
+    char const *name;
+    bhv::node::ptr (*make)();
+  } const shapes[] = {{"agent", &make_agent}, {"crowd", &make_crowd}};
+
+  std::printf("%-6s %-8s %10s %7s %14s %10s %10s %10s %9s %9s\n", "shape",
+              "engine", "instances", "threads", "ticks/s", "p50(us)",
+              "p99(us)", "p999(us)", "rss(MB)", "bytes/inst");
+
+  for (auto const &shape : shapes) {
+    if (!opts.selected(shape.name))
+      continue;
+    for (size_t count : opts.instances) {
+      for (size_t threads : opts.threads) {
+        run_dynamic(opts, shape.name, shape.make, count, threads);
+        run_flat(opts, shape.name, shape.make, count, threads);
+      }
+    }
+  }
+}
+
+} // namespace bench
@@ -0,0 +1,146 @@
+#include "bench.hpp"
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <cstdio>
+#include <functional>
+
+using namespace cppttl;
+
+namespace {
+
+using builder = std::function<bhv::node::ptr(bhv::status)>;
+
+int selected = 0;
+unsigned branch = 0;
+
+bhv::node::ptr leaf(bhv::status st) {
+  return bhv::make_node<bhv::action>("leaf", [st] { return st; });
+}
+
+bhv::node::ptr pass() {
+  return bhv::make_node<bhv::condition>("pass", [] { return true; });
+}
+
+bhv::node::ptr fail() {
+  return bhv::make_node<bhv::condition>("fail", [] { return false; });
+}
+
+// sequence(pass, sequence(pass, ... leaf))
+builder sequence_chain(size_t depth) {
+  return [depth](bhv::status st) {
+    auto child = leaf(st);
+    for (size_t i = 0; i < depth; ++i) {
+      auto seq = bhv::make_node<bhv::sequence>("seq");
+      seq->add(pass()).add(std::move(child));
+      child = std::move(seq);
+    }
+    return child;
+  };
+}
+
+// fallback(fail, fail, ... leaf)
+builder wide_fallback(size_t width) {
+  return [width](bhv::status st) {
+    auto fal = bhv::make_node<bhv::fallback>("fal");
+    for (size_t i = 1; i < width; ++i)
+      fal->add(fail());
+    fal->add(leaf(st));
+    return bhv::node::ptr(std::move(fal));
+  };
+}
+
+builder parallel(size_t width, size_t threshold) {
+  return [width, threshold](bhv::status st) {
+    auto par = bhv::make_node<bhv::parallel>("par", threshold);
+    for (size_t i = 0; i < width; ++i)
+      par->add(leaf(st));
+    return bhv::node::ptr(std::move(par));
+  };
+}
+
+// The last case is selected
+builder predicate_switch(int cases) {
+  return [cases](bhv::status st) {
+    selected = cases - 1;
+    auto sw = bhv::make_node<bhv::switch_>("switch");
+    for (int i = 0; i < cases; ++i)
+      sw->case_<bhv::condition>("case", [i] { return selected == i; })
+          .handler(leaf(st));
+    return bhv::node::ptr(std::move(sw));
+  };
+}
+
+builder keyed_switch(int cases) {
+  return [cases](bhv::status st) {
+    selected = cases - 1;
+    auto sw = bhv::make_node<bhv::switch_>("switch", [] { return selected; });
+    for (int i = 0; i < cases; ++i)
+      sw->case_(i).handler(leaf(st));
+    return bhv::node::ptr(std::move(sw));
+  };
+}
+
+// invert(invert(... leaf))
+builder decorators(size_t depth) {
+  return [depth](bhv::status st) {
+    auto child = leaf(st);
+    for (size_t i = 0; i < depth; ++i) {
+      auto inv = bhv::make_node<bhv::invert>("inv");
+      inv->child(std::move(child));
+      child = std::move(inv);
+    }
+    return child;
+  };
+}
+
+// The branches alternate
+builder branches() {
+  return [](bhv::status st) {
+    auto stmt = bhv::make_node<bhv::if_>(
+        "if", bhv::condition("cond", [] { return ++branch % 2 == 0; }));
+    stmt->then_(leaf(st)).else_(leaf(st));
+    return bhv::node::ptr(std::move(stmt));
+  };
+}
+
+void run(bench::options const &opts, char const *shape, builder const &build) {
+  for (auto st : {bhv::status::success, bhv::status::running}) {
+    auto const name = std::string(shape) + "/" + bhv::to_string(st);
+    if (!opts.selected(name))
+      continue;
+
+    auto root = build(st);
+    double const dynamic =
+        bench::ns_per_tick(opts, [&root] { (*root)(); });
+
+    bhv::flat_tree const tree(*root);
+    auto state = tree.make_state();
+    double const flat =
+        bench::ns_per_tick(opts, [&tree, &state] { tree(state); });
+
+    std::printf("%-40s %12.1f %12.1f\n", name.c_str(), dynamic, flat);
+  }
+}
+
+} // namespace
+
+namespace bench {
+
+void tick_suite(options const &opts) {
+  std::printf("%-40s %12s %12s\n", "ns/tick", "dynamic", "flat");
+
+  run(opts, "sequence/depth=8", sequence_chain(8));
+  run(opts, "sequence/depth=64", sequence_chain(64));
+  run(opts, "fallback/width=8", wide_fallback(8));
+  run(opts, "fallback/width=64", wide_fallback(64));
+  run(opts, "parallel/width=16/threshold=1", parallel(16, 1));
+  run(opts, "parallel/width=16/threshold=8", parallel(16, 8));
+  run(opts, "parallel/width=16/threshold=16", parallel(16, 16));
+  run(opts, "switch/cases=64", predicate_switch(64));
+  run(opts, "keyed_switch/cases=64", keyed_switch(64));
+  run(opts, "decorators/depth=8", decorators(8));
+  run(opts, "decorators/depth=64", decorators(64));
+  run(opts, "if/alternating", branches());
+}
+
+} // namespace bench
@@ -0,0 +1,61 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvarena.hpp"
+
+namespace cppttl {
+namespace bhv {
+
+arena::scope::scope(arena &ref)
+    : _prev(set_memory_resource(ref.resource())) {}
+
+arena::scope::~scope() { set_memory_resource(_prev); }
+
+arena::arena(size_t initial_size) : _resource(initial_size) {}
+
+std::pmr::memory_resource *arena::resource() { return &_resource; }
+
+size_t arena::used() const { return _resource.used(); }
+
+arena::counted_resource::counted_resource(size_t initial_size)
+    : _blocks(initial_size) {}
+
+size_t arena::counted_resource::used() const { return _used; }
+
+void *arena::counted_resource::do_allocate(size_t bytes, size_t alignment) {
+  void *p = _blocks.allocate(bytes, alignment);
+  _used += bytes;
+  return p;
+}
+
+void arena::counted_resource::do_deallocate(void *p, size_t bytes,
+                                            size_t alignment) {
+  _blocks.deallocate(p, bytes, alignment);
+}
+
+bool arena::counted_resource::do_is_equal(
+    std::pmr::memory_resource const &other) const noexcept {
+  return this == &other;
+}
+
+} // namespace bhv
+} // namespace cppttl
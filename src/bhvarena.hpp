@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief The arena allocates whole trees (nodes, child lists and control
+ * blocks) from large memory blocks. Memory is never returned to the system
+ * until the arena is destroyed, so the teardown is a single release.
+ *
+ * The arena must outlive all the nodes allocated from it. The arena isn't
+ * thread-safe, so the trees are built in it by one thread at a time. The trees
+ * built by build() have their execution state allocated in advance, so ticking
+ * them doesn't touch the arena and they can be ticked on any thread.
+ */
+class arena {
+public:
+  /**
+   * @brief RAII guard installing the arena as the memory resource of the
+   * calling thread. All the nodes created while the guard exists are allocated
+   * from the arena.
+   */
+  class scope {
+  public:
+    explicit scope(arena &ref);
+    ~scope();
+
+    scope(scope const &) = delete;
+    scope &operator=(scope const &) = delete;
+
+  private:
+    std::pmr::memory_resource *_prev;
+  };
+
+  explicit arena(size_t initial_size = 4096);
+
+  arena(arena const &) = delete;
+  arena &operator=(arena const &) = delete;
+
+  std::pmr::memory_resource *resource();
+
+  /**
+   * @brief Number of bytes allocated from the arena
+   */
+  size_t used() const;
+
+  /**
+   * @brief Build the tree in the arena and allocate its execution state
+   *
+   * @param [in] fn                 Function returning the root node by value
+   * @return std::shared_ptr<Node>  The root node allocated from the arena
+   */
+  template <typename Fn, typename Node = std::decay_t<std::invoke_result_t<Fn>>>
+  std::shared_ptr<Node> build(Fn &&fn);
+
+private:
+  class counted_resource : public std::pmr::memory_resource {
+  public:
+    explicit counted_resource(size_t initial_size);
+    size_t used() const;
+
+  private:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const &other) const
+        noexcept override;
+
+    std::pmr::monotonic_buffer_resource _blocks;
+    size_t _used{};
+  };
+
+  counted_resource _resource;
+};
+
+template <typename Fn, typename Node>
+std::shared_ptr<Node> arena::build(Fn &&fn) {
+  scope guard(*this);
+  auto root = make_node<Node>(std::forward<Fn>(fn)());
+  root->prepare();
+  return root;
+}
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvasync.hpp"
+
+namespace cppttl {
+namespace bhv {
+
+// cancellation
+cancellation::cancellation(std::atomic<bool> const &flag) : _flag(flag) {}
+
+bool cancellation::requested() const {
+  return _flag.load(std::memory_order_relaxed);
+}
+
+// async
+async::state::state(executor &e, work &&f) : ex(e), fn(std::move(f)) {}
+
+void async::state::run() {
+  if (!cancelled.load(std::memory_order_relaxed)) {
+    try {
+      result = fn(cancellation(cancelled));
+    } catch (...) {
+      exception = std::current_exception();
+    }
+  }
+
+  phase expected = phase::pending;
+  if (!current.compare_exchange_strong(expected, phase::done,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    // The work was cancelled, the result is discarded
+    exception = nullptr;
+    current.store(phase::idle, std::memory_order_release);
+  }
+}
+
+status async::operator()() const {
+  state &st = *_state;
+
+  switch (st.current.load(std::memory_order_acquire)) {
+  case phase::idle: {
+    st.cancelled.store(false, std::memory_order_relaxed);
+    st.current.store(phase::pending, std::memory_order_relaxed);
+    try {
+      st.ex.submit([ptr = _state] { ptr->run(); });
+    } catch (...) {
+      st.current.store(phase::idle, std::memory_order_relaxed);
+      throw;
+    }
+    return status::running;
+  }
+  case phase::pending:
+  case phase::cancelled:
+    return status::running;
+  case phase::done:
+    break;
+  }
+
+  st.current.store(phase::idle, std::memory_order_relaxed);
+
+  if (st.exception)
+    std::rethrow_exception(std::exchange(st.exception, nullptr));
+
+  return st.result;
+}
+
+void async::halt() const {
+  phase expected = phase::pending;
+  if (_state->current.compare_exchange_strong(expected, phase::cancelled,
+                                              std::memory_order_relaxed)) {
+    _state->cancelled.store(true, std::memory_order_relaxed);
+  } else if (expected == phase::done) {
+    // The result isn't consumed yet, discard it
+    _state->exception = nullptr;
+    _state->current.store(phase::idle, std::memory_order_relaxed);
+  }
+}
+
+} // namespace bhv
+} // namespace cppttl
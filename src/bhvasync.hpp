@@ -0,0 +1,130 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvexecutor.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Cancellation request observed by the asynchronous work
+ */
+class cancellation {
+public:
+  explicit cancellation(std::atomic<bool> const &flag);
+
+  /**
+   * @brief The action was halted and the result will be discarded
+   */
+  bool requested() const;
+
+private:
+  std::atomic<bool> const &_flag;
+};
+
+/**
+ * @brief The action callable running the work on the executor.
+ * The first tick of the activation submits the work and returns the running
+ * status. The next ticks return the running status until the work is completed
+ * and then return its result or rethrow its exception. The ticking thread is
+ * never blocked.
+ *
+ * Halting the action requests the cancellation: the work which hasn't started
+ * yet is skipped, and the result of the work in progress is discarded. The
+ * next activation doesn't start until the cancelled work is finished, so the
+ * work never runs concurrently with itself.
+ *
+ * The work can take the cancellation object to check the cancellation request.
+ * The executor and everything referenced by the work must outlive the action.
+ */
+class async {
+public:
+  using work = inplace_function<status(cancellation const &)>;
+
+  template <typename Fn, typename = std::enable_if_t<
+                             std::is_invocable_r_v<status, Fn &> ||
+                             std::is_invocable_r_v<status, Fn &,
+                                                   cancellation const &>>>
+  async(executor &ex, Fn &&fn);
+
+  status operator()() const;
+
+  /**
+   * @brief Request the cancellation of the work in progress
+   */
+  void halt() const;
+
+private:
+  enum class phase { idle, pending, done, cancelled };
+
+  struct state {
+    executor &ex;
+    work fn;
+    std::atomic<phase> current{phase::idle};
+    std::atomic<bool> cancelled{};
+    status result = status::failure;
+    std::exception_ptr exception;
+
+    state(executor &e, work &&f);
+    void run();
+  };
+
+  template <typename Fn> static work wrap(Fn &&fn);
+
+  std::shared_ptr<state> _state;
+};
+
+template <typename Fn, typename>
+async::async(executor &ex, Fn &&fn)
+    : _state(std::allocate_shared<state>(allocator<state>(), ex,
+                                         wrap(std::forward<Fn>(fn)))) {}
+
+template <typename Fn> async::work async::wrap(Fn &&fn) {
+  if constexpr (std::is_invocable_r_v<status, std::decay_t<Fn> &,
+                                      cancellation const &>) {
+    return work(std::forward<Fn>(fn));
+  } else {
+    return work([fn = std::forward<Fn>(fn)](cancellation const &) mutable {
+      return fn();
+    });
+  }
+}
+
+/**
+ * @brief Create the action running the work on the executor. Halting the
+ * action cancels the work.
+ */
+template <typename Fn>
+action async_action(std::string_view name, executor &ex, Fn &&fn) {
+  async work(ex, std::forward<Fn>(fn));
+  return action(name, work, [work] { work.halt(); });
+}
+
+} // namespace bhv
+} // namespace cppttl
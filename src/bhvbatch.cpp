@@ -0,0 +1,730 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvbatch.hpp"
+#include <stdexcept>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+namespace {
+
+// The state layout is the same as in the flat_tree, but every state slot is
+// stored as an array with an element per agent.
+
+// if_ states
+enum : size_t { condition_state, then_state, else_state, break_state };
+
+// switch_ states
+enum : size_t { match_state, exec_state };
+
+// switch_ state slots:
+// [state, handlers number, match statuses[count], (handler, status)[count]]
+size_t const switch_handlers = 1;
+size_t const switch_header = 2;
+
+size_t to_slot(status st) { return static_cast<size_t>(st); }
+status to_status(size_t slot) { return static_cast<status>(slot); }
+
+void check_range(agents const &active, size_t size) {
+  for (auto agent : active) {
+    if (agent >= size)
+      throw std::runtime_error("The agent index is out of range");
+  }
+}
+
+} // namespace
+
+// agents
+agents::agents(size_t const *data, size_t size) : _data(data), _size(size) {}
+
+agents::agents(std::vector<size_t> const &list)
+    : _data(list.data()), _size(list.size()) {}
+
+size_t const *agents::begin() const { return _data; }
+
+size_t const *agents::end() const { return _data + _size; }
+
+size_t agents::size() const { return _size; }
+
+bool agents::empty() const { return _size == 0; }
+
+size_t agents::operator[](size_t i) const { return _data[i]; }
+
+// batch
+void batch::frame::clear() {
+  agents.clear();
+  positions.clear();
+  slots.clear();
+}
+
+void batch::frame::push(size_t agent, size_t position) {
+  agents.push_back(agent);
+  positions.push_back(position);
+}
+
+batch::batch(flat_tree const &tree, size_t size)
+    : _tree(tree), _size(size), _state(tree.nodes_state_size() * size),
+      _leaves(tree.records().size()), _all(size), _results(size) {
+  for (size_t i = 0; i < size; ++i)
+    _all[i] = i;
+}
+
+size_t batch::size() const { return _size; }
+
+batch &batch::bind(std::string_view name, leaf fn, halt_handler halt) {
+  auto const &records = _tree.records();
+
+  for (size_t i = 0; i < records.size(); ++i) {
+    auto const &rec = records[i];
+    if ((rec.type == node_type::action || rec.type == node_type::condition) &&
+        rec.source->name() == name)
+      _leaves[i] = {fn, halt};
+  }
+
+  return *this;
+}
+
+std::vector<status> const &batch::operator()() {
+  tick(0, agents(_all), _results.data(), 0);
+  return _results;
+}
+
+void batch::operator()(agents const &active, status *results) {
+  check_range(active, _size);
+  tick(0, active, results, 0);
+}
+
+void batch::halt() { halt(_tree.records().front(), agents(_all)); }
+
+void batch::halt(agents const &active) {
+  check_range(active, _size);
+  halt(_tree.records().front(), active);
+}
+
+batch::frame &batch::scratch(size_t depth) {
+  // std::deque keeps the references to the frames of outer nodes valid
+  while (_frames.size() <= depth)
+    _frames.emplace_back();
+  return _frames[depth];
+}
+
+size_t &batch::slot(record const &rec, size_t offset, size_t agent) {
+  return _state[(rec.state + offset) * _size + agent];
+}
+
+void batch::reset(record const &rec, size_t agent) {
+  size_t const slots = flat_tree::state_size(rec);
+  for (size_t i = 0; i < slots; ++i)
+    slot(rec, i, agent) = 0;
+}
+
+void batch::reset(record const &rec, agents const &active) {
+  for (auto agent : active)
+    reset(rec, agent);
+}
+
+void batch::halt(record const &rec, size_t agent) {
+  auto halt_child = [this, agent](index child) {
+    if (child != flat_tree::npos)
+      halt(_tree.records()[child], agent);
+  };
+
+  switch (rec.type) {
+  case node_type::action: {
+    size_t &running = slot(rec, 0, agent);
+    if (!running)
+      return;
+    running = 0;
+    auto const &bound = _leaves[&rec - _tree.records().data()];
+    if (bound.fn) {
+      if (bound.halt)
+        bound.halt(agent);
+      return;
+    }
+    auto const &fn = static_cast<action const *>(rec.source)->halt_fn();
+    if (fn)
+      fn();
+    return;
+  }
+  case node_type::sequence:
+  case node_type::fallback:
+  case node_type::if_: {
+    size_t const pos = slot(rec, 0, agent);
+    if (pos < rec.count)
+      halt_child(link(rec, pos));
+    break;
+  }
+  case node_type::parallel:
+    for (size_t c = 0; c < rec.count; ++c) {
+      if (to_status(slot(rec, c, agent)) == status::running)
+        halt_child(link(rec, c));
+    }
+    break;
+  case node_type::switch_: {
+    size_t const handlers = slot(rec, switch_handlers, agent);
+    size_t const match_statuses = switch_header;
+    size_t const handler_statuses = switch_header + rec.count;
+
+    if (slot(rec, 0, agent) == match_state) {
+      for (size_t c = 0; c < rec.count; ++c) {
+        if (to_status(slot(rec, match_statuses + c, agent)) == status::running)
+          halt_child(link(rec, c));
+      }
+    } else if (handlers) {
+      for (size_t h = 0; h < handlers; ++h) {
+        if (to_status(slot(rec, handler_statuses + h * 2 + 1, agent)) ==
+            status::running)
+          halt_child(
+              static_cast<index>(slot(rec, handler_statuses + h * 2, agent)));
+      }
+    } else {
+      halt_child(link(rec, rec.count * 2));
+    }
+    break;
+  }
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force:
+    halt_child(link(rec, 0));
+    break;
+  default:
+    return;
+  }
+
+  reset(rec, agent);
+}
+
+void batch::halt(record const &rec, agents const &active) {
+  for (auto agent : active)
+    halt(rec, agent);
+}
+
+batch::index batch::link(record const &rec, size_t i) const {
+  return _tree.links()[rec.first + i];
+}
+
+void batch::tick(index idx, agents const &active, status *results,
+                 size_t depth) {
+  if (active.empty())
+    return;
+
+  record const &rec = _tree.records()[idx];
+
+  switch (rec.type) {
+  case node_type::action:
+  case node_type::condition:
+    return tick_leaf(idx, active, results);
+  case node_type::sequence:
+    return tick_chain(rec, active, results, depth, status::success);
+  case node_type::fallback:
+    return tick_chain(rec, active, results, depth, status::failure);
+  case node_type::parallel:
+    return tick_parallel(rec, active, results, depth);
+  case node_type::if_:
+    return tick_if(rec, active, results, depth);
+  case node_type::switch_:
+    return tick_switch(rec, active, results, depth);
+  case node_type::invert:
+    return tick_invert(rec, active, results, depth);
+  case node_type::repeat:
+    return tick_loop(rec, active, results, depth, status::success);
+  case node_type::retry:
+    return tick_loop(rec, active, results, depth, status::failure);
+  case node_type::force:
+    return tick_force(rec, active, results, depth);
+  case node_type::reactive:
+  case node_type::custom:
+    break;
+  }
+
+  throw std::runtime_error("Unsupported node type");
+}
+
+void batch::tick_leaf(index idx, agents const &active, status *results) {
+  record const &rec = _tree.records()[idx];
+  bool const is_action = rec.type == node_type::action;
+
+  // The action which throws an exception isn't running anymore
+  if (is_action)
+    reset(rec, active);
+
+  if (_leaves[idx].fn) {
+    _leaves[idx].fn(active, results);
+  } else if (is_action) {
+    auto const &fn = static_cast<action const *>(rec.source)->fn();
+    for (size_t i = 0; i < active.size(); ++i)
+      results[i] = fn();
+  } else {
+    auto const &fn = static_cast<condition const *>(rec.source)->fn();
+    for (size_t i = 0; i < active.size(); ++i)
+      results[i] = fn() ? status::success : status::failure;
+  }
+
+  if (is_action) {
+    for (size_t i = 0; i < active.size(); ++i)
+      slot(rec, 0, active[i]) = results[i] == status::running;
+  }
+}
+
+// sequence and fallback
+void batch::tick_chain(record const &rec, agents const &active,
+                       status *results, size_t depth, status proceed) {
+  frame &f = scratch(depth);
+
+  try {
+    // Positions only grow, so the agents are gathered child by child
+    for (size_t c = 0; c < rec.count; ++c) {
+      f.clear();
+      for (size_t i = 0; i < active.size(); ++i) {
+        if (slot(rec, 0, active[i]) == c)
+          f.push(active[i], i);
+      }
+
+      if (f.agents.empty())
+        continue;
+
+      f.results.resize(f.agents.size());
+      tick(link(rec, c), agents(f.agents), f.results.data(), depth + 1);
+
+      for (size_t i = 0; i < f.agents.size(); ++i) {
+        status const st = f.results[i];
+        if (st == proceed) {
+          ++slot(rec, 0, f.agents[i]);
+          continue;
+        }
+        results[f.positions[i]] = st;
+        if (st != status::running)
+          reset(rec, f.agents[i]);
+      }
+    }
+
+    for (size_t i = 0; i < active.size(); ++i) {
+      if (slot(rec, 0, active[i]) >= rec.count) {
+        results[i] = proceed;
+        reset(rec, active[i]);
+      }
+    }
+  } catch (...) {
+    halt(rec, active);
+    throw;
+  }
+}
+
+void batch::tick_parallel(record const &rec, agents const &active,
+                          status *results, size_t depth) {
+  frame &f = scratch(depth);
+  size_t const count = rec.count;
+
+  // The numbers of the succeeded and the failed children of the agents
+  auto &counters = f.counters;
+  counters.assign(active.size() * 2, 0);
+
+  auto count_status = [&counters](size_t i, status st) {
+    if (st == status::success)
+      ++counters[i * 2];
+    else if (st == status::failure)
+      ++counters[i * 2 + 1];
+  };
+
+  auto decided = [&counters, &rec, count](size_t i) {
+    return counters[i * 2] >= rec.param ||
+           counters[i * 2 + 1] > count - rec.param;
+  };
+
+  try {
+    for (size_t i = 0; i < active.size(); ++i) {
+      for (size_t c = 0; c < count; ++c)
+        count_status(i, to_status(slot(rec, c, active[i])));
+    }
+
+    // The children left after the outcome of the agent is decided are halted
+    for (size_t c = 0; c < count; ++c) {
+      f.clear();
+      for (size_t i = 0; i < active.size(); ++i) {
+        if (!decided(i) &&
+            to_status(slot(rec, c, active[i])) == status::running)
+          f.push(active[i], i);
+      }
+
+      if (f.agents.empty())
+        continue;
+
+      f.results.resize(f.agents.size());
+      tick(link(rec, c), agents(f.agents), f.results.data(), depth + 1);
+
+      for (size_t i = 0; i < f.agents.size(); ++i) {
+        slot(rec, c, f.agents[i]) = to_slot(f.results[i]);
+        count_status(f.positions[i], f.results[i]);
+      }
+    }
+
+    for (size_t i = 0; i < active.size(); ++i) {
+      size_t const success = counters[i * 2];
+      size_t const failed = counters[i * 2 + 1];
+
+      results[i] = success >= rec.param           ? status::success
+                   : failed > count - rec.param ? status::failure
+                                                  : status::running;
+
+      if (results[i] != status::running)
+        halt(rec, active[i]);
+    }
+  } catch (...) {
+    halt(rec, active);
+    throw;
+  }
+}
+
+void batch::tick_if(record const &rec, agents const &active, status *results,
+                    size_t depth) {
+  if (link(rec, condition_state) == flat_tree::npos)
+    throw std::runtime_error("There is no condition node under the 'if' node");
+
+  frame &f = scratch(depth);
+
+  try {
+    // The condition is evaluated first, so the agents moved to the branches
+    // are processed in the same pass
+    for (size_t phase = condition_state; phase < break_state; ++phase) {
+      f.clear();
+      for (size_t i = 0; i < active.size(); ++i) {
+        if (slot(rec, 0, active[i]) == phase)
+          f.push(active[i], i);
+      }
+
+      if (f.agents.empty())
+        continue;
+
+      index const child = link(rec, phase);
+
+      if (child == flat_tree::npos) {
+        for (size_t i = 0; i < f.agents.size(); ++i) {
+          results[f.positions[i]] = status::failure;
+          reset(rec, f.agents[i]);
+        }
+        continue;
+      }
+
+      f.results.resize(f.agents.size());
+      tick(child, agents(f.agents), f.results.data(), depth + 1);
+
+      for (size_t i = 0; i < f.agents.size(); ++i) {
+        status const st = f.results[i];
+
+        if (st == status::running) {
+          results[f.positions[i]] = st;
+        } else if (phase == condition_state) {
+          slot(rec, 0, f.agents[i]) =
+              st == status::success ? then_state : else_state;
+        } else {
+          results[f.positions[i]] = st;
+          reset(rec, f.agents[i]);
+        }
+      }
+    }
+  } catch (...) {
+    halt(rec, active);
+    throw;
+  }
+}
+
+void batch::tick_switch(record const &rec, agents const &active,
+                        status *results, size_t depth) {
+  frame &f = scratch(depth);
+  size_t const match_statuses = switch_header;
+  size_t const handler_statuses = switch_header + rec.count;
+  index const default_handler = link(rec, rec.count * 2);
+
+  try {
+    // Match the cases
+    for (size_t c = 0; c < rec.count; ++c) {
+      f.clear();
+      for (size_t i = 0; i < active.size(); ++i) {
+        if (slot(rec, 0, active[i]) == match_state &&
+            to_status(slot(rec, match_statuses + c, active[i])) ==
+                status::running)
+          f.push(active[i], i);
+      }
+
+      if (f.agents.empty())
+        continue;
+
+      f.results.resize(f.agents.size());
+      tick(link(rec, c), agents(f.agents), f.results.data(), depth + 1);
+
+      for (size_t i = 0; i < f.agents.size(); ++i)
+        slot(rec, match_statuses + c, f.agents[i]) = to_slot(f.results[i]);
+    }
+
+    for (size_t i = 0; i < active.size(); ++i) {
+      size_t const agent = active[i];
+
+      if (slot(rec, 0, agent) != match_state)
+        continue;
+
+      size_t running = {};
+      size_t matched = {};
+
+      for (size_t c = 0; c < rec.count; ++c) {
+        status const st = to_status(slot(rec, match_statuses + c, agent));
+        if (st == status::running)
+          ++running;
+        else if (st == status::success)
+          ++matched;
+      }
+
+      if (running) {
+        results[i] = status::running;
+        continue;
+      }
+
+      if (matched) {
+        // Collect the matched handlers, the same handler is executed once
+        size_t &handlers = slot(rec, switch_handlers, agent);
+        index mapped_handler = flat_tree::npos;
+
+        for (size_t c = 0; c < rec.count; ++c) {
+          size_t &case_st = slot(rec, match_statuses + c, agent);
+          index const handler = link(rec, rec.count + c);
+
+          if (to_status(case_st) == status::success &&
+              mapped_handler != handler) {
+            mapped_handler = handler;
+            slot(rec, handler_statuses + handlers * 2, agent) = handler;
+            slot(rec, handler_statuses + handlers * 2 + 1, agent) =
+                to_slot(status::running);
+            ++handlers;
+          }
+
+          case_st = to_slot(status::running);
+        }
+      }
+
+      slot(rec, 0, agent) = exec_state;
+    }
+
+    // Execute the matched handlers in the order of cases
+    index handler = flat_tree::npos;
+
+    for (size_t c = 0; c < rec.count; ++c) {
+      if (link(rec, rec.count + c) == handler)
+        continue;
+      handler = link(rec, rec.count + c);
+
+      f.clear();
+      for (size_t i = 0; i < active.size(); ++i) {
+        size_t const agent = active[i];
+
+        if (slot(rec, 0, agent) != exec_state)
+          continue;
+
+        size_t const handlers = slot(rec, switch_handlers, agent);
+
+        for (size_t h = 0; h < handlers; ++h) {
+          if (slot(rec, handler_statuses + h * 2, agent) == handler &&
+              to_status(slot(rec, handler_statuses + h * 2 + 1, agent)) ==
+                  status::running) {
+            f.push(agent, i);
+            f.slots.push_back(handler_statuses + h * 2 + 1);
+            break;
+          }
+        }
+      }
+
+      if (f.agents.empty())
+        continue;
+
+      f.results.resize(f.agents.size());
+      tick(handler, agents(f.agents), f.results.data(), depth + 1);
+
+      for (size_t i = 0; i < f.agents.size(); ++i)
+        slot(rec, f.slots[i], f.agents[i]) = to_slot(f.results[i]);
+    }
+
+    // Execute the default handler
+    f.clear();
+    for (size_t i = 0; i < active.size(); ++i) {
+      size_t const agent = active[i];
+      if (slot(rec, 0, agent) == exec_state &&
+          slot(rec, switch_handlers, agent) == 0)
+        f.push(agent, i);
+    }
+
+    if (!f.agents.empty()) {
+      f.results.resize(f.agents.size());
+
+      if (default_handler != flat_tree::npos) {
+        tick(default_handler, agents(f.agents), f.results.data(), depth + 1);
+      } else {
+        for (auto &st : f.results)
+          st = status::failure;
+      }
+
+      for (size_t i = 0; i < f.agents.size(); ++i)
+        results[f.positions[i]] = f.results[i];
+    }
+
+    // Collect the results
+    for (size_t i = 0; i < active.size(); ++i) {
+      size_t const agent = active[i];
+
+      if (slot(rec, 0, agent) != exec_state)
+        continue;
+
+      size_t const handlers = slot(rec, switch_handlers, agent);
+
+      if (handlers) {
+        size_t running = {};
+        size_t failed = {};
+
+        for (size_t h = 0; h < handlers; ++h) {
+          status const st =
+              to_status(slot(rec, handler_statuses + h * 2 + 1, agent));
+          if (st == status::running)
+            ++running;
+          if (st == status::failure)
+            ++failed;
+        }
+
+        results[i] = running != 0  ? status::running
+                     : failed != 0 ? status::failure
+                                   : status::success;
+      }
+
+      if (results[i] != status::running)
+        reset(rec, agent);
+    }
+  } catch (...) {
+    halt(rec, active);
+    throw;
+  }
+}
+
+void batch::tick_invert(record const &rec, agents const &active,
+                        status *results, size_t depth) {
+  index const child = link(rec, 0);
+  if (child == flat_tree::npos)
+    throw std::runtime_error(
+        "There is no controllable node under the 'invert' node");
+
+  tick(child, active, results, depth + 1);
+
+  for (size_t i = 0; i < active.size(); ++i) {
+    switch (results[i]) {
+    case status::success:
+      results[i] = status::failure;
+      break;
+    case status::failure:
+      results[i] = status::success;
+      break;
+    case status::running:
+      break;
+    default:
+      throw std::runtime_error("The child node returned an unknown status");
+    }
+  }
+}
+
+// repeat and retry
+void batch::tick_loop(record const &rec, agents const &active,
+                      status *results, size_t depth, status proceed) {
+  index const child = link(rec, 0);
+  if (child == flat_tree::npos)
+    throw std::runtime_error(
+        rec.type == node_type::repeat
+            ? "There is no controllable node under the 'repeat' node"
+            : "There is no controllable node under the 'retry' node");
+
+  size_t const step = rec.param == repeat::infinitely ? 0 : 1;
+  status const stop =
+      proceed == status::success ? status::failure : status::success;
+  frame &f = scratch(depth);
+
+  try {
+    f.clear();
+    for (size_t i = 0; i < active.size(); ++i) {
+      if (slot(rec, 0, active[i]) < rec.param) {
+        f.push(active[i], i);
+      } else {
+        results[i] = proceed;
+        reset(rec, active[i]);
+      }
+    }
+
+    while (!f.agents.empty()) {
+      f.results.resize(f.agents.size());
+      tick(child, agents(f.agents), f.results.data(), depth + 1);
+
+      // Agents which continue the loop are compacted in place
+      size_t n = {};
+
+      for (size_t i = 0; i < f.agents.size(); ++i) {
+        size_t const agent = f.agents[i];
+        status const st = f.results[i];
+
+        if (st == proceed) {
+          size_t &counter = slot(rec, 0, agent);
+          counter += step;
+          if (counter < rec.param) {
+            f.agents[n] = agent;
+            f.positions[n] = f.positions[i];
+            ++n;
+            continue;
+          }
+          results[f.positions[i]] = proceed;
+          reset(rec, agent);
+        } else if (st == stop) {
+          results[f.positions[i]] = stop;
+          reset(rec, agent);
+        } else {
+          results[f.positions[i]] = status::running;
+        }
+      }
+
+      f.agents.resize(n);
+      f.positions.resize(n);
+    }
+  } catch (...) {
+    halt(rec, active);
+    throw;
+  }
+}
+
+void batch::tick_force(record const &rec, agents const &active,
+                       status *results, size_t depth) {
+  index const child = link(rec, 0);
+  if (child == flat_tree::npos)
+    throw std::runtime_error(
+        "There is no controllable node under the 'force' node");
+
+  tick(child, active, results, depth + 1);
+
+  for (size_t i = 0; i < active.size(); ++i) {
+    if (results[i] != status::running)
+      results[i] = to_status(rec.param);
+  }
+}
+
+} // namespace bhv
+} // namespace cppttl
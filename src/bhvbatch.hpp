@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvflat.hpp"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Read-only view of the agent indices
+ */
+class agents {
+public:
+  agents(size_t const *data, size_t size);
+  agents(std::vector<size_t> const &list);
+
+  size_t const *begin() const;
+  size_t const *end() const;
+  size_t size() const;
+  bool empty() const;
+  size_t operator[](size_t i) const;
+
+private:
+  size_t const *_data;
+  size_t _size;
+};
+
+/**
+ * @brief The batch runner ticks the same flat tree for many instances (agents)
+ * in one call. The state of all instances is kept in structure-of-arrays form,
+ * so every node processes all the agents positioned on it in a single pass.
+ *
+ * Leaves can be bound to batch handlers which receive the indices of all active
+ * agents at once. Unbound leaves fall back to the leaf callables of the source
+ * tree, invoked once per agent.
+ *
+ * The running actions are halted the same way as in the flat tree. If a leaf
+ * throws an exception, the agents ticked by the nodes on the path to the leaf
+ * are halted.
+ */
+class batch {
+public:
+  using index = flat_tree::index;
+  using record = flat_tree::record;
+
+  /**
+   * @brief Batch leaf handler. It must write the status of every active agent
+   * to the results array, in the order of the agent indices.
+   */
+  using leaf = std::function<void(agents const &active, status *results)>;
+
+  /**
+   * @brief Batch halt handler. It's called for every agent whose bound action
+   * is halted while running.
+   */
+  using halt_handler = std::function<void(size_t agent)>;
+
+  batch(flat_tree const &tree, size_t size);
+
+  size_t size() const;
+
+  /**
+   * @brief Bind all the action and condition leaves with the given name to the
+   * batch handler. The bound actions are halted by the batch halt handler
+   * instead of the halt handler of the source action.
+   */
+  batch &bind(std::string_view name, leaf fn, halt_handler halt = {});
+
+  /**
+   * @brief Tick all the instances
+   *
+   * @return The statuses of the instances
+   */
+  std::vector<status> const &operator()();
+
+  /**
+   * @brief Tick the given instances
+   *
+   * @param [in]  active  Indices of the instances to tick
+   * @param [out] results Statuses of the instances in the order of indices
+   */
+  void operator()(agents const &active, status *results);
+
+  /**
+   * @brief Halt the running nodes of all the instances and reset their state
+   */
+  void halt();
+
+  /**
+   * @brief Halt the running nodes of the given instances and reset their state
+   */
+  void halt(agents const &active);
+
+private:
+  struct binding {
+    leaf fn;
+    halt_handler halt;
+  };
+
+  struct frame {
+    std::vector<size_t> agents;
+    std::vector<size_t> positions;
+    std::vector<size_t> slots;
+    std::vector<status> results;
+    std::vector<size_t> counters; // Not cleared, used by the parallel nodes
+
+    void clear();
+    void push(size_t agent, size_t position);
+  };
+
+  frame &scratch(size_t depth);
+  size_t &slot(record const &rec, size_t offset, size_t agent);
+  void reset(record const &rec, size_t agent);
+  void reset(record const &rec, agents const &active);
+  void halt(record const &rec, size_t agent);
+  void halt(record const &rec, agents const &active);
+  index link(record const &rec, size_t i) const;
+
+  void tick(index idx, agents const &active, status *results, size_t depth);
+  void tick_leaf(index idx, agents const &active, status *results);
+  void tick_chain(record const &rec, agents const &active, status *results,
+                  size_t depth, status proceed);
+  void tick_parallel(record const &rec, agents const &active, status *results,
+                     size_t depth);
+  void tick_if(record const &rec, agents const &active, status *results,
+               size_t depth);
+  void tick_switch(record const &rec, agents const &active, status *results,
+                   size_t depth);
+  void tick_invert(record const &rec, agents const &active, status *results,
+                   size_t depth);
+  void tick_loop(record const &rec, agents const &active, status *results,
+                 size_t depth, status proceed);
+  void tick_force(record const &rec, agents const &active, status *results,
+                  size_t depth);
+
+private:
+  flat_tree const &_tree;
+  size_t const _size;
+  std::vector<size_t> _state;
+  std::vector<binding> _leaves;
+  std::deque<frame> _frames;
+  std::vector<size_t> _all;
+  std::vector<status> _results;
+};
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,311 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define BHVT_COROUTINES 1
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Pool of coroutine frames bound to the memory resource which was
+ * active when the pool was created. The coroutine frames of the same action
+ * have the same size, so the last released frame is kept and reused by the
+ * next activation.
+ */
+class frame_pool {
+public:
+  frame_pool() : _resource(get_memory_resource()) {}
+  ~frame_pool();
+
+  frame_pool(frame_pool const &) = delete;
+  frame_pool &operator=(frame_pool const &) = delete;
+
+  void *allocate(size_t &size);
+  void deallocate(void *ptr, size_t size) noexcept;
+
+  /**
+   * @brief The pool used for the coroutine frames created on the calling thread
+   */
+  static frame_pool *&current();
+
+private:
+  std::pmr::memory_resource *_resource;
+  void *_block = nullptr;
+  size_t _size = {};
+};
+
+inline frame_pool::~frame_pool() {
+  if (_block)
+    _resource->deallocate(_block, _size, alignof(std::max_align_t));
+}
+
+inline void *frame_pool::allocate(size_t &size) {
+  if (_block && _size >= size) {
+    size = _size;
+    return std::exchange(_block, nullptr);
+  }
+  return _resource->allocate(size, alignof(std::max_align_t));
+}
+
+inline void frame_pool::deallocate(void *ptr, size_t size) noexcept {
+  if (!_block) {
+    _block = ptr;
+    _size = size;
+  } else if (_size < size) {
+    void *const prev = std::exchange(_block, ptr);
+    _resource->deallocate(prev, std::exchange(_size, size),
+                          alignof(std::max_align_t));
+  } else {
+    _resource->deallocate(ptr, size, alignof(std::max_align_t));
+  }
+}
+
+inline frame_pool *&frame_pool::current() {
+  static thread_local frame_pool *pool = nullptr;
+  return pool;
+}
+
+/**
+ * @brief The return type of the action coroutines.
+ * The coroutine suspends until the next tick with 'co_yield status::running'
+ * and completes with 'co_return status', the returned status is the final
+ * status of the action. Yielding any other status throws std::runtime_error
+ * from the tick. The coroutine doesn't start until the first tick.
+ */
+class task {
+public:
+  class promise_type {
+  public:
+    task get_return_object() {
+      return task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(status st);
+    void return_value(status st) noexcept { _status = st; }
+    void unhandled_exception() { _exception = std::current_exception(); }
+
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size) noexcept;
+
+  private:
+    // The frame header keeps the origin of the frame memory
+    struct alignas(std::max_align_t) header {
+      frame_pool *pool;
+      std::pmr::memory_resource *resource;
+      size_t size;
+    };
+
+    status _status = status::running;
+    std::exception_ptr _exception;
+
+    friend class task;
+  };
+
+  task() noexcept = default;
+  task(task &&other) noexcept;
+  task &operator=(task &&other) noexcept;
+  task(task const &) = delete;
+  task &operator=(task const &) = delete;
+  ~task();
+
+  explicit operator bool() const noexcept;
+
+  /**
+   * @brief Resume the coroutine until the next suspension point
+   *
+   * @return status The returned status if the coroutine is completed,
+   *                otherwise status::running
+   */
+  status resume();
+
+private:
+  using handle = std::coroutine_handle<promise_type>;
+
+  explicit task(handle h) noexcept : _handle(h) {}
+
+  handle _handle;
+};
+
+inline void *task::promise_type::operator new(size_t size) {
+  frame_pool *pool = frame_pool::current();
+  std::pmr::memory_resource *resource = pool ? nullptr : get_memory_resource();
+  size_t block_size = size + sizeof(header);
+  void *block = pool ? pool->allocate(block_size)
+                     : resource->allocate(block_size,
+                                          alignof(std::max_align_t));
+  ::new (block) header{pool, resource, block_size};
+  return static_cast<header *>(block) + 1;
+}
+
+inline void task::promise_type::operator delete(void *ptr, size_t) noexcept {
+  header *block = static_cast<header *>(ptr) - 1;
+  if (block->pool)
+    block->pool->deallocate(block, block->size);
+  else
+    block->resource->deallocate(block, block->size,
+                                alignof(std::max_align_t));
+}
+
+inline std::suspend_always task::promise_type::yield_value(status st) {
+  // The final status is returned with co_return
+  if (st != status::running)
+    throw std::runtime_error("The coroutine can yield status::running only");
+  return {};
+}
+
+inline task::task(task &&other) noexcept
+    : _handle(std::exchange(other._handle, nullptr)) {}
+
+inline task &task::operator=(task &&other) noexcept {
+  if (this != &other) {
+    if (_handle)
+      _handle.destroy();
+    _handle = std::exchange(other._handle, nullptr);
+  }
+  return *this;
+}
+
+inline task::~task() {
+  if (_handle)
+    _handle.destroy();
+}
+
+inline task::operator bool() const noexcept { return bool(_handle); }
+
+inline status task::resume() {
+  if (!_handle || _handle.done())
+    throw std::runtime_error("The coroutine is already completed");
+
+  _handle.resume();
+
+  auto &promise = _handle.promise();
+  if (promise._exception)
+    std::rethrow_exception(std::exchange(promise._exception, nullptr));
+
+  return _handle.done() ? promise._status : status::running;
+}
+
+/**
+ * @brief The action callable running the coroutine.
+ * Every activation of the action creates a new coroutine from the factory
+ * function and resumes it on every tick until it completes. The coroutine
+ * frame is destroyed on completion, on exception and on halt.
+ *
+ * The frames are allocated from the frame pool bound to the memory resource
+ * which was active when the callable was created, e.g. the tree arena.
+ * Copies of the callable share the same coroutine.
+ */
+class coroutine {
+public:
+  using factory = inplace_function<task()>;
+
+  template <typename Fn, typename = std::enable_if_t<
+                             std::is_same_v<std::invoke_result_t<Fn &>, task>>>
+  explicit coroutine(Fn &&fn);
+
+  status operator()() const;
+
+  /**
+   * @brief Destroy the running coroutine
+   */
+  void halt() const;
+
+private:
+  struct state {
+    factory fn;
+    frame_pool pool; // The pool must outlive the frame
+    task current;
+
+    explicit state(factory &&f) : fn(std::move(f)) {}
+  };
+
+  std::shared_ptr<state> _state;
+};
+
+template <typename Fn, typename>
+coroutine::coroutine(Fn &&fn)
+    : _state(std::allocate_shared<state>(allocator<state>(),
+                                         factory(std::forward<Fn>(fn)))) {}
+
+inline status coroutine::operator()() const {
+  state &st = *_state;
+
+  if (!st.current) {
+    frame_pool *const prev = std::exchange(frame_pool::current(), &st.pool);
+    try {
+      st.current = st.fn();
+    } catch (...) {
+      frame_pool::current() = prev;
+      throw;
+    }
+    frame_pool::current() = prev;
+  }
+
+  status result;
+
+  try {
+    result = st.current.resume();
+  } catch (...) {
+    st.current = {};
+    throw;
+  }
+
+  if (result != status::running)
+    st.current = {};
+
+  return result;
+}
+
+inline void coroutine::halt() const { _state->current = {}; }
+
+/**
+ * @brief Create the action running the coroutine. The coroutine is destroyed
+ * when the action is halted.
+ */
+template <typename Fn>
+action coroutine_action(std::string_view name, Fn &&fn) {
+  coroutine co(std::forward<Fn>(fn));
+  return action(name, co, [co] { co.halt(); });
+}
+
+} // namespace bhv
+} // namespace cppttl
+
+#elif defined(BHVT_REQUIRE_COROUTINES)
+#error "The coroutine actions require C++20 with the coroutine support"
+#endif
@@ -0,0 +1,150 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvexecutor.hpp"
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+namespace {
+// The pool and the queue index of the current worker thread
+thread_local thread_pool const *current_pool = nullptr;
+thread_local size_t current_queue = {};
+} // namespace
+
+// executor
+executor::~executor() {}
+
+bool executor::run_one() { return false; }
+
+// thread_pool
+thread_pool::thread_pool(size_t threads) {
+  if (!threads)
+    threads = 1;
+
+  _queues.reserve(threads);
+  for (size_t i = 0; i < threads; ++i)
+    _queues.emplace_back(std::make_unique<queue>());
+
+  _threads.reserve(threads);
+  for (size_t i = 0; i < threads; ++i)
+    _threads.emplace_back(&thread_pool::worker, this, i);
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+  }
+  _cv.notify_all();
+
+  for (auto &thread : _threads)
+    thread.join();
+}
+
+size_t thread_pool::size() const { return _threads.size(); }
+
+void thread_pool::submit(task fn) {
+  size_t const idx = current_pool == this
+                         ? current_queue
+                         : _next.fetch_add(1, std::memory_order_relaxed) %
+                               _queues.size();
+
+  _pending.fetch_add(1, std::memory_order_release);
+
+  {
+    std::lock_guard<std::mutex> guard(_queues[idx]->lock);
+    _queues[idx]->tasks.emplace_back(std::move(fn));
+  }
+
+  // Synchronize with the workers checking the pending tasks before sleeping
+  { std::lock_guard<std::mutex> guard(_lock); }
+  _cv.notify_one();
+}
+
+bool thread_pool::run_one() {
+  task fn;
+
+  if (current_pool == this ? !pop(current_queue, fn)
+                           : !steal(_queues.size(), fn))
+    return false;
+
+  fn();
+  return true;
+}
+
+void thread_pool::worker(size_t idx) {
+  current_pool = this;
+  current_queue = idx;
+
+  for (;;) {
+    task fn;
+
+    if (pop(idx, fn)) {
+      fn();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+    _cv.wait(guard, [this] {
+      return _stop || _pending.load(std::memory_order_acquire) != 0;
+    });
+
+    if (_stop && _pending.load(std::memory_order_acquire) == 0)
+      break;
+  }
+}
+
+bool thread_pool::pop(size_t idx, task &fn) {
+  {
+    auto &own = *_queues[idx];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      fn = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      _pending.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return steal(idx, fn);
+}
+
+bool thread_pool::steal(size_t idx, task &fn) {
+  size_t const n = _queues.size();
+
+  for (size_t i = 1; i <= n; ++i) {
+    auto &victim = *_queues[(idx + i) % n];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      fn = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      _pending.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace bhv
+} // namespace cppttl
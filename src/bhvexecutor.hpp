@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief The interface of task executors
+ */
+class executor {
+public:
+  using task = inplace_function<void()>;
+
+  virtual ~executor();
+
+  /**
+   * @brief Schedule the task for execution. Tasks must not throw exceptions.
+   */
+  virtual void submit(task fn) = 0;
+
+  /**
+   * @brief Execute one pending task on the calling thread.
+   * It's used to help the executor while waiting for the submitted tasks.
+   *
+   * @return true   The task was executed
+   * @return false  There are no pending tasks
+   */
+  virtual bool run_one();
+};
+
+/**
+ * @brief The pool of worker threads with a task queue per worker.
+ * Tasks submitted from a worker are pushed to its own queue, idle workers
+ * steal tasks from the queues of other workers.
+ */
+class thread_pool final : public executor {
+public:
+  explicit thread_pool(size_t threads = std::thread::hardware_concurrency());
+  ~thread_pool() override;
+
+  thread_pool(thread_pool const &) = delete;
+  thread_pool &operator=(thread_pool const &) = delete;
+
+  size_t size() const;
+
+  void submit(task fn) override;
+  bool run_one() override;
+
+private:
+  struct queue {
+    std::mutex lock;
+    std::deque<task> tasks;
+  };
+
+  void worker(size_t idx);
+  bool pop(size_t idx, task &fn);
+  bool steal(size_t idx, task &fn);
+
+private:
+  std::vector<std::unique_ptr<queue>> _queues;
+  std::vector<std::thread> _threads;
+  std::atomic<size_t> _pending{};
+  std::atomic<size_t> _next{};
+  std::mutex _lock;
+  std::condition_variable _cv;
+  bool _stop = false;
+};
+
+} // namespace bhv
+} // namespace cppttl
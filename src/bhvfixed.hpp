@@ -0,0 +1,585 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Behavior trees composed at compile time.
+ * Children are stored by value as template parameters, so the whole tree is
+ * a single type without virtual calls, shared pointers or type-erased
+ * callables and can be inlined by the compiler. The nodes follow the same
+ * execution and state semantics as the dynamic ones.
+ */
+namespace fixed {
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// execution nodes
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * @brief Placeholder for the missing if/then/else branch or halt handler
+ */
+struct none {
+  void halt() {}
+};
+
+/**
+ * @brief An action node performs some useful task and returns the status.
+ * The optional halt handler is called when the running action is halted.
+ */
+template <typename Fn, typename Halt = none> class action {
+public:
+  static_assert(std::is_same_v<std::invoke_result_t<Fn &>, status>,
+                "The action must return the status");
+
+  action(std::string_view name, Fn fn, Halt halt = {})
+      : _name(name), _fn(std::move(fn)), _halt(std::move(halt)) {}
+
+  std::string_view name() const { return _name; }
+
+  status operator()() {
+    _running = false;
+    status const st = _fn();
+    _running = st == status::running;
+    return st;
+  }
+
+  void halt() {
+    if (!_running)
+      return;
+    _running = false;
+    if constexpr (!std::is_same_v<Halt, none>)
+      _halt();
+  }
+
+private:
+  std::string_view _name;
+  Fn _fn;
+  Halt _halt;
+  bool _running = false;
+};
+
+template <typename Fn> action(std::string_view, Fn) -> action<Fn>;
+template <typename Fn, typename Halt>
+action(std::string_view, Fn, Halt) -> action<Fn, Halt>;
+
+/**
+ * @brief A condition node is a predicate returning success or failure.
+ */
+template <typename Fn> class condition {
+public:
+  static_assert(std::is_same_v<std::invoke_result_t<Fn &>, bool>,
+                "The condition must return the boolean value");
+
+  condition(std::string_view name, Fn fn) : _name(name), _fn(std::move(fn)) {}
+
+  std::string_view name() const { return _name; }
+  status operator()() { return _fn() ? status::success : status::failure; }
+  void halt() {}
+
+private:
+  std::string_view _name;
+  Fn _fn;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// control nodes
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template <typename... Childs> class basic_control {
+public:
+  static constexpr size_t size = sizeof...(Childs);
+
+  basic_control(std::string_view name, Childs... childs)
+      : _name(name), _childs(std::move(childs)...) {}
+
+  std::string_view name() const { return _name; }
+  std::tuple<Childs...> const &childs() const { return _childs; }
+
+protected:
+  // Halt the children for which the predicate returns true
+  template <typename Pred> void halt_childs(Pred &&pred) {
+    halt_childs(pred, std::index_sequence_for<Childs...>{});
+  }
+
+  template <typename Pred, size_t... I>
+  void halt_childs(Pred &pred, std::index_sequence<I...>) {
+    ((pred(I) ? std::get<I>(_childs).halt() : void()), ...);
+  }
+
+  std::string_view _name;
+  std::tuple<Childs...> _childs;
+};
+
+// ->
+/**
+ * @brief A sequence node executes all child nodes in turn until one of them
+ * fails or all of them succeed.
+ */
+template <typename... Childs> class sequence : public basic_control<Childs...> {
+public:
+  using base = basic_control<Childs...>;
+  using base::base;
+
+  status operator()() {
+    status st = status::success;
+
+    try {
+      tick(st, std::index_sequence_for<Childs...>{});
+      if (st != status::running)
+        _running = 0;
+    } catch (...) {
+      _running = 0;
+      throw;
+    }
+
+    return st;
+  }
+
+  void halt() {
+    this->halt_childs([this](size_t i) { return i == _running; });
+    _running = 0;
+  }
+
+private:
+  template <size_t... I> void tick(status &st, std::index_sequence<I...>) {
+    (void)((I < _running || step<I>(st)) && ...);
+  }
+
+  template <size_t I> bool step(status &st) {
+    st = std::get<I>(this->_childs)();
+    if (st != status::success)
+      return false;
+    ++_running;
+    return true;
+  }
+
+private:
+  size_t _running{};
+};
+
+template <typename... Childs>
+sequence(std::string_view, Childs...) -> sequence<Childs...>;
+
+// ?
+/**
+ * @brief The fallback node executes all child nodes until one of them succeeds,
+ * otherwise it fails.
+ */
+template <typename... Childs> class fallback : public basic_control<Childs...> {
+public:
+  using base = basic_control<Childs...>;
+  using base::base;
+
+  status operator()() {
+    status st = status::failure;
+
+    try {
+      tick(st, std::index_sequence_for<Childs...>{});
+      if (st != status::running)
+        _running = 0;
+    } catch (...) {
+      _running = 0;
+      throw;
+    }
+
+    return st;
+  }
+
+  void halt() {
+    this->halt_childs([this](size_t i) { return i == _running; });
+    _running = 0;
+  }
+
+private:
+  template <size_t... I> void tick(status &st, std::index_sequence<I...>) {
+    (void)((I < _running || step<I>(st)) && ...);
+  }
+
+  template <size_t I> bool step(status &st) {
+    st = std::get<I>(this->_childs)();
+    if (st != status::failure)
+      return false;
+    ++_running;
+    return true;
+  }
+
+private:
+  size_t _running{};
+};
+
+template <typename... Childs>
+fallback(std::string_view, Childs...) -> fallback<Childs...>;
+
+// =>
+/**
+ * @brief The parallel node executes all the child nodes until at least M nodes
+ * succeed, otherwise it fails.
+ */
+template <typename... Childs> class parallel : public basic_control<Childs...> {
+public:
+  using base = basic_control<Childs...>;
+
+  parallel(std::string_view name, size_t threshold, Childs... childs)
+      : base(name, std::move(childs)...), _threshold(threshold) {
+    reset();
+  }
+
+  size_t threshold() const { return _threshold; }
+
+  status operator()() {
+    status st = status::success;
+
+    try {
+      size_t success = {};
+      size_t failed = {};
+
+      tick(success, failed, std::index_sequence_for<Childs...>{});
+
+      st = success >= _threshold                ? status::success
+           : failed > base::size - _threshold ? status::failure
+                                                : status::running;
+
+      if (st != status::running)
+        halt();
+    } catch (...) {
+      halt();
+      throw;
+    }
+
+    return st;
+  }
+
+  void halt() {
+    this->halt_childs(
+        [this](size_t i) { return _statuses[i] == status::running; });
+    reset();
+  }
+
+private:
+  template <size_t... I>
+  void tick(size_t &success, size_t &failed, std::index_sequence<I...>) {
+    for (auto st : _statuses) {
+      if (st == status::success)
+        ++success;
+      else if (st == status::failure)
+        ++failed;
+    }
+
+    // The children left after the outcome is decided are halted
+    (step<I>(success, failed) && ...);
+  }
+
+  bool decided(size_t success, size_t failed) const {
+    return success >= _threshold || failed > base::size - _threshold;
+  }
+
+  template <size_t I> bool step(size_t &success, size_t &failed) {
+    if (decided(success, failed))
+      return false;
+
+    auto &st = _statuses[I];
+
+    if (st == status::running) {
+      st = std::get<I>(this->_childs)();
+      if (st == status::success)
+        ++success;
+      else if (st == status::failure)
+        ++failed;
+    }
+    return true;
+  }
+
+  void reset() { _statuses.fill(status::running); }
+
+private:
+  size_t _threshold;
+  std::array<status, sizeof...(Childs)> _statuses;
+};
+
+template <typename... Childs>
+parallel(std::string_view, size_t, Childs...) -> parallel<Childs...>;
+
+// if/then/else
+/**
+ * @brief An if-else statement controls conditional branching.
+ * Missing branches are declared with the 'none' type.
+ */
+template <typename Condition, typename Then = none, typename Else = none>
+class if_ : public basic_control<Condition, Then, Else> {
+public:
+  using base = basic_control<Condition, Then, Else>;
+
+  if_(std::string_view name, Condition condition, Then then_ = {},
+      Else else_ = {})
+      : base(name, std::move(condition), std::move(then_), std::move(else_)) {}
+
+  status operator()() {
+    status st = status::failure;
+
+    try {
+      do {
+        switch (_state) {
+        case state::condition_state:
+          st = std::get<0>(this->_childs)();
+          break;
+        case state::then_state:
+          if constexpr (std::is_same_v<Then, none>) {
+            reset();
+            return status::failure;
+          } else {
+            st = std::get<1>(this->_childs)();
+          }
+          break;
+        case state::else_state:
+          if constexpr (std::is_same_v<Else, none>) {
+            reset();
+            return status::failure;
+          } else {
+            st = std::get<2>(this->_childs)();
+          }
+          break;
+        case state::break_state:
+          break;
+        }
+
+        switch (st) {
+        case status::running:
+          return st;
+        case status::success:
+          _state = _state == state::condition_state ? state::then_state
+                                                    : state::break_state;
+          break;
+        case status::failure:
+          _state = _state == state::condition_state ? state::else_state
+                                                    : state::break_state;
+          break;
+        }
+      } while (_state != state::break_state);
+
+      reset();
+    } catch (...) {
+      reset();
+      throw;
+    }
+
+    return st;
+  }
+
+  void halt() {
+    this->halt_childs([this](size_t i) {
+      return i == static_cast<size_t>(_state);
+    });
+    reset();
+  }
+
+private:
+  void reset() { _state = state::condition_state; }
+
+private:
+  enum class state { condition_state, then_state, else_state, break_state };
+
+  state _state = state::condition_state;
+};
+
+template <typename Condition>
+if_(std::string_view, Condition) -> if_<Condition>;
+template <typename Condition, typename Then>
+if_(std::string_view, Condition, Then) -> if_<Condition, Then>;
+template <typename Condition, typename Then, typename Else>
+if_(std::string_view, Condition, Then, Else) -> if_<Condition, Then, Else>;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// decorators
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * @brief A node for inverting the child result.
+ */
+template <typename Child> class invert : public basic_control<Child> {
+public:
+  using base = basic_control<Child>;
+  using base::base;
+
+  status operator()() {
+    switch (std::get<0>(this->_childs)()) {
+    case status::success:
+      return status::failure;
+    case status::failure:
+      return status::success;
+    case status::running:
+      return status::running;
+    }
+
+    throw std::runtime_error("The child node returned an unknown status");
+  }
+
+  void halt() { std::get<0>(this->_childs).halt(); }
+};
+
+template <typename Child> invert(std::string_view, Child) -> invert<Child>;
+
+/**
+ * @brief Repeat the child node N times.
+ */
+template <typename Child> class repeat : public basic_control<Child> {
+public:
+  using base = basic_control<Child>;
+
+  static constexpr auto infinitely = bhv::repeat::infinitely;
+
+  repeat(std::string_view name, size_t repeat_n, Child child)
+      : base(name, std::move(child)), _n(repeat_n) {}
+
+  size_t count() const { return _n; }
+
+  status operator()() {
+    const auto step = _n == infinitely ? 0ull : 1ull;
+
+    try {
+      for (; _i < _n; _i += step) {
+        switch (std::get<0>(this->_childs)()) {
+        case status::success:
+          break;
+        case status::failure:
+          _i = 0;
+          return status::failure;
+        case status::running:
+          return status::running;
+        }
+      }
+
+      _i = 0;
+    } catch (...) {
+      _i = 0;
+      throw;
+    }
+
+    return status::success;
+  }
+
+  void halt() {
+    std::get<0>(this->_childs).halt();
+    _i = 0;
+  }
+
+private:
+  size_t const _n;
+  size_t _i = {};
+};
+
+template <typename Child>
+repeat(std::string_view, size_t, Child) -> repeat<Child>;
+
+/**
+ * @brief Retry the child node N times until it returns a successful state.
+ */
+template <typename Child> class retry : public basic_control<Child> {
+public:
+  using base = basic_control<Child>;
+
+  static constexpr auto infinitely = bhv::retry::infinitely;
+
+  retry(std::string_view name, size_t repeat_n, Child child)
+      : base(name, std::move(child)), _n(repeat_n) {}
+
+  size_t count() const { return _n; }
+
+  status operator()() {
+    const auto step = _n == infinitely ? 0ull : 1ull;
+
+    try {
+      for (; _i < _n; _i += step) {
+        switch (std::get<0>(this->_childs)()) {
+        case status::success:
+          _i = 0;
+          return status::success;
+        case status::failure:
+          break;
+        case status::running:
+          return status::running;
+        }
+      }
+
+      _i = 0;
+    } catch (...) {
+      _i = 0;
+      throw;
+    }
+
+    return status::failure;
+  }
+
+  void halt() {
+    std::get<0>(this->_childs).halt();
+    _i = 0;
+  }
+
+private:
+  size_t const _n;
+  size_t _i = {};
+};
+
+template <typename Child>
+retry(std::string_view, size_t, Child) -> retry<Child>;
+
+/**
+ * @brief Force change the child status
+ */
+template <typename Child> class force : public basic_control<Child> {
+public:
+  using base = basic_control<Child>;
+
+  force(std::string_view name, status st, Child child)
+      : base(name, std::move(child)), _status(st) {}
+
+  status result() const { return _status; }
+
+  status operator()() {
+    if (std::get<0>(this->_childs)() == status::running)
+      return status::running;
+    return _status;
+  }
+
+  void halt() { std::get<0>(this->_childs).halt(); }
+
+private:
+  status const _status;
+};
+
+template <typename Child>
+force(std::string_view, status, Child) -> force<Child>;
+
+} // namespace fixed
+} // namespace bhv
+} // namespace cppttl
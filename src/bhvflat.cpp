@@ -0,0 +1,690 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvflat.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace cppttl {
+namespace bhv {
+namespace {
+
+// if_ states
+enum : size_t { condition_state, then_state, else_state, break_state };
+
+// switch_ states
+enum : size_t { match_state, exec_state };
+
+// switch_ state block layout:
+// [state, handlers number, match statuses[count], (handler, status)[count]]
+size_t const switch_header = 2;
+
+size_t node_state_size(node_type type, flat_tree::index count) {
+  switch (type) {
+  case node_type::action: // The action is running
+  case node_type::sequence:
+  case node_type::fallback:
+  case node_type::if_:
+  case node_type::repeat:
+  case node_type::retry:
+    return 1;
+  case node_type::parallel:
+    return count;
+  case node_type::switch_:
+    return switch_header + count * 3;
+  default:
+    break;
+  }
+  return 0;
+}
+
+size_t to_slot(status st) { return static_cast<size_t>(st); }
+status to_status(size_t slot) { return static_cast<status>(slot); }
+
+status inverted(status st) {
+  switch (st) {
+  case status::success:
+    return status::failure;
+  case status::failure:
+    return status::success;
+  case status::running:
+    return status::running;
+  }
+
+  throw std::runtime_error("The child node returned an unknown status");
+}
+
+} // namespace
+
+flat_tree::flat_tree(node const &root) {
+  compile(root, 0);
+
+  // The active path follows the node states: [length, index[depth]]
+  _path = _state_size;
+  _state_size += 1 + _depth;
+}
+
+flat_tree::records_list const &flat_tree::records() const { return _records; }
+
+flat_tree::links_list const &flat_tree::links() const { return _links; }
+
+size_t flat_tree::state_size() const { return _state_size; }
+
+size_t flat_tree::nodes_state_size() const { return _path; }
+
+size_t flat_tree::state_size(record const &rec) {
+  return node_state_size(rec.type, rec.count);
+}
+
+flat_tree::index flat_tree::compile(node::cptr const &ref, size_t depth) {
+  return ref ? compile(*ref, depth) : npos;
+}
+
+flat_tree::index flat_tree::compile(node const &ref, size_t depth) {
+  // The reactive node is transparent, its child is evaluated on every tick
+  if (ref.type() == node_type::reactive) {
+    auto const &childs = static_cast<reactive const &>(ref).childs();
+    if (childs.empty() || !childs.front())
+      throw std::runtime_error(
+          "There is no controllable node under the 'reactive' node");
+    return compile(*childs.front(), depth);
+  }
+
+  if (_records.size() >= npos)
+    throw std::runtime_error("The behavior tree is too large");
+
+  index const idx = static_cast<index>(_records.size());
+  _depth = std::max(_depth, depth + 1);
+  _records.push_back({ref.type(), 0, 0, 0, 0, &ref});
+
+  auto reserve_links = [this, idx](size_t count) {
+    _records[idx].first = static_cast<index>(_links.size());
+    _records[idx].count = static_cast<index>(count);
+    _links.resize(_links.size() + count, npos);
+    return _records[idx].first;
+  };
+
+  switch (ref.type()) {
+  case node_type::action:
+  case node_type::condition:
+    break;
+  case node_type::sequence:
+  case node_type::fallback:
+  case node_type::parallel: {
+    auto const &childs = static_cast<basic_control const &>(ref).childs();
+    index const first = reserve_links(childs.size());
+    for (size_t i = 0; i < childs.size(); ++i)
+      _links[first + i] = compile(childs[i], depth + 1);
+    if (ref.type() == node_type::parallel)
+      _records[idx].param = static_cast<parallel const &>(ref).threshold();
+    break;
+  }
+  case node_type::if_: {
+    auto const &stmt = static_cast<if_ const &>(ref);
+    index const first = reserve_links(3);
+    _links[first + condition_state] = compile(stmt.condition(), depth + 1);
+    _links[first + then_state] = compile(stmt.then_(), depth + 1);
+    _links[first + else_state] = compile(stmt.else_(), depth + 1);
+    break;
+  }
+  case node_type::switch_: {
+    // links layout: [conditions[count], handlers[count], default handler]
+    auto const &stmt = static_cast<switch_ const &>(ref);
+    size_t count = {};
+    for (auto it = stmt.begin(); it != stmt.end(); ++it)
+      ++count;
+    index const first = reserve_links(count * 2 + 1);
+    _records[idx].count = static_cast<index>(count);
+
+    size_t i = 0;
+    node::cptr handler;
+    index handler_idx = npos;
+    for (auto &&case_ : stmt) {
+      _links[first + i] = compile(case_.condition(), depth + 1);
+      if (!handler || handler != case_.handler()) {
+        handler = case_.handler();
+        handler_idx = compile(handler, depth + 1);
+      }
+      _links[first + count + i] = handler_idx;
+      ++i;
+    }
+
+    _links[first + count * 2] = compile(stmt.default_handler(), depth + 1);
+    break;
+  }
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force: {
+    auto const &childs = static_cast<basic_control const &>(ref).childs();
+    index const first = reserve_links(1);
+    if (!childs.empty())
+      _links[first] = compile(childs.front(), depth + 1);
+    if (ref.type() == node_type::repeat)
+      _records[idx].param = static_cast<repeat const &>(ref).count();
+    else if (ref.type() == node_type::retry)
+      _records[idx].param = static_cast<retry const &>(ref).count();
+    else if (ref.type() == node_type::force)
+      _records[idx].param = to_slot(static_cast<force const &>(ref).result());
+    break;
+  }
+  case node_type::reactive:
+  case node_type::custom:
+    throw std::runtime_error("Unsupported node type");
+  }
+
+  _records[idx].state = static_cast<index>(_state_size);
+  _state_size += node_state_size(ref.type(), _records[idx].count);
+
+  return idx;
+}
+
+flat_tree::state flat_tree::make_state() const {
+  return state(_state_size, 0);
+}
+
+status flat_tree::operator()(state &st) const {
+  if (st.size() != _state_size)
+    throw std::runtime_error(
+        "The state block does not correspond to the flat tree");
+
+  size_t *const block = st.data();
+  size_t &length = block[_path];
+
+  try {
+    status const result = length ? resume(block) : tick(0, block, 0);
+    if (result != status::running)
+      length = 0;
+    return result;
+  } catch (...) {
+    length = 0;
+    throw;
+  }
+}
+
+void flat_tree::halt(state &st) const {
+  if (st.size() != _state_size)
+    throw std::runtime_error(
+        "The state block does not correspond to the flat tree");
+  halt(_records.front(), st.data());
+  std::fill(st.begin() + _path, st.end(), 0);
+}
+
+status flat_tree::tick(index idx, size_t *block, size_t depth) const {
+  record const &rec = _records[idx];
+  block[_path + 1 + depth] = idx;
+
+  switch (rec.type) {
+  case node_type::action:
+    return tick_action(rec, block, depth);
+  case node_type::condition:
+    return static_cast<condition const *>(rec.source)->fn()()
+               ? status::success
+               : status::failure;
+  case node_type::sequence:
+    return tick_chain(rec, block, depth, status::success);
+  case node_type::fallback:
+    return tick_chain(rec, block, depth, status::failure);
+  case node_type::parallel:
+    return tick_parallel(rec, block, depth);
+  case node_type::if_:
+    return tick_if(rec, block, depth);
+  case node_type::switch_:
+    return tick_switch(rec, block, depth);
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force:
+    return tick_decorator(rec, block, depth);
+  case node_type::reactive:
+  case node_type::custom:
+    break;
+  }
+
+  throw std::runtime_error("Unsupported node type");
+}
+
+status flat_tree::resume(size_t *block) const {
+  size_t const *const path = block + _path + 1;
+  size_t depth = block[_path] - 1;
+
+  try {
+    // Ancestors of the running node only pass the running status through, so
+    // they are visited only when the running node is completed.
+    status st = tick(static_cast<index>(path[depth]), block, depth);
+
+    while (st != status::running && depth-- > 0)
+      st = resume(_records[path[depth]], block, depth, st);
+
+    return st;
+  } catch (...) {
+    // The node which has thrown the exception is already reset
+    for (size_t i = 0; i < depth; ++i)
+      reset(_records[path[i]], block);
+    throw;
+  }
+}
+
+status flat_tree::resume(record const &rec, size_t *block, size_t depth,
+                         status st) const {
+  switch (rec.type) {
+  case node_type::sequence:
+    return resume_chain(rec, block, depth, st, status::success);
+  case node_type::fallback:
+    return resume_chain(rec, block, depth, st, status::failure);
+  case node_type::if_:
+    return resume_if(rec, block, depth, st);
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force:
+    return resume_decorator(rec, block, depth, st);
+  default:
+    break;
+  }
+
+  throw std::runtime_error("Unsupported node type");
+}
+
+void flat_tree::halt(record const &rec, size_t *block) const {
+  index const *const childs = &_links[rec.first];
+
+  auto halt_child = [this, block](index child) {
+    if (child != npos)
+      halt(_records[child], block);
+  };
+
+  switch (rec.type) {
+  case node_type::action: {
+    size_t &running = block[rec.state];
+    if (!running)
+      return;
+    running = 0;
+    auto const &fn = static_cast<action const *>(rec.source)->halt_fn();
+    if (fn)
+      fn();
+    return;
+  }
+  case node_type::sequence:
+  case node_type::fallback:
+  case node_type::if_: {
+    size_t const pos = block[rec.state];
+    if (pos < rec.count)
+      halt_child(childs[pos]);
+    break;
+  }
+  case node_type::parallel:
+    for (size_t i = 0; i < rec.count; ++i) {
+      if (to_status(block[rec.state + i]) == status::running)
+        halt_child(childs[i]);
+    }
+    break;
+  case node_type::switch_: {
+    size_t const handlers = block[rec.state + 1];
+    size_t const *const match_statuses = &block[rec.state + switch_header];
+    size_t const *const handler_statuses = match_statuses + rec.count;
+
+    if (block[rec.state] == match_state) {
+      for (size_t i = 0; i < rec.count; ++i) {
+        if (to_status(match_statuses[i]) == status::running)
+          halt_child(childs[i]);
+      }
+    } else if (handlers) {
+      for (size_t i = 0; i < handlers; ++i) {
+        if (to_status(handler_statuses[i * 2 + 1]) == status::running)
+          halt_child(static_cast<index>(handler_statuses[i * 2]));
+      }
+    } else {
+      halt_child(childs[rec.count * 2]);
+    }
+    break;
+  }
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force:
+    halt_child(childs[0]);
+    break;
+  default:
+    return;
+  }
+
+  reset(rec, block);
+}
+
+void flat_tree::reset(record const &rec, size_t *block) const {
+  auto first = block + rec.state;
+  std::fill(first, first + state_size(rec), 0);
+}
+
+status flat_tree::tick_action(record const &rec, size_t *block,
+                              size_t depth) const {
+  size_t &running = block[rec.state];
+  running = 0;
+  status const st = static_cast<action const *>(rec.source)->fn()();
+  running = st == status::running;
+  if (running)
+    block[_path] = depth + 1;
+  return st;
+}
+
+status flat_tree::tick_chain(record const &rec, size_t *block, size_t depth,
+                             status proceed) const {
+  size_t const pos = block[rec.state];
+
+  if (pos >= rec.count) {
+    reset(rec, block);
+    return proceed;
+  }
+
+  status st;
+
+  try {
+    st = tick(_links[rec.first + pos], block, depth + 1);
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return resume_chain(rec, block, depth, st, proceed);
+}
+
+status flat_tree::resume_chain(record const &rec, size_t *block, size_t depth,
+                               status st, status proceed) const {
+  size_t &pos = block[rec.state];
+
+  try {
+    while (st == proceed && ++pos < rec.count)
+      st = tick(_links[rec.first + pos], block, depth + 1);
+
+    if (st != status::running)
+      reset(rec, block);
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return st;
+}
+
+status flat_tree::tick_parallel(record const &rec, size_t *block,
+                                 size_t depth) const {
+  status st = status::success;
+
+  try {
+    size_t success = {};
+    size_t failed = {};
+    size_t const count = rec.count;
+
+    for (size_t i = 0; i < count; ++i) {
+      status const child_st = to_status(block[rec.state + i]);
+      if (child_st == status::success)
+        ++success;
+      else if (child_st == status::failure)
+        ++failed;
+    }
+
+    // The children left after the outcome is decided are halted
+    for (size_t i = 0;
+         i < count && success < rec.param && failed <= count - rec.param; ++i) {
+      size_t &child_st = block[rec.state + i];
+
+      if (to_status(child_st) != status::running)
+        continue;
+
+      child_st = to_slot(tick(_links[rec.first + i], block, depth + 1));
+      if (to_status(child_st) == status::success)
+        ++success;
+      else if (to_status(child_st) == status::failure)
+        ++failed;
+    }
+
+    st = success >= rec.param           ? status::success
+         : failed > count - rec.param ? status::failure
+                                        : status::running;
+
+    if (st != status::running)
+      halt(rec, block);
+    else
+      block[_path] = depth + 1;
+  } catch (...) {
+    halt(rec, block);
+    throw;
+  }
+
+  return st;
+}
+
+status flat_tree::tick_if(record const &rec, size_t *block,
+                          size_t depth) const {
+  if (_links[rec.first + condition_state] == npos)
+    throw std::runtime_error("There is no condition node under the 'if' node");
+
+  index const child = _links[rec.first + block[rec.state]];
+
+  if (child == npos) {
+    reset(rec, block);
+    return status::failure;
+  }
+
+  status st;
+
+  try {
+    st = tick(child, block, depth + 1);
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return resume_if(rec, block, depth, st);
+}
+
+status flat_tree::resume_if(record const &rec, size_t *block, size_t depth,
+                            status st) const {
+  size_t &phase = block[rec.state];
+
+  try {
+    while (st != status::running) {
+      if (phase != condition_state) { // the branch is completed
+        reset(rec, block);
+        return st;
+      }
+
+      phase = st == status::success ? then_state : else_state;
+      index const child = _links[rec.first + phase];
+
+      if (child == npos) {
+        reset(rec, block);
+        return status::failure;
+      }
+
+      st = tick(child, block, depth + 1);
+    }
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return st;
+}
+
+status flat_tree::tick_switch(record const &rec, size_t *block,
+                               size_t depth) const {
+  size_t &phase = block[rec.state];
+  size_t &handlers = block[rec.state + 1];
+  size_t *const match_statuses = &block[rec.state + switch_header];
+  size_t *const handler_statuses = match_statuses + rec.count;
+  index const *const conditions = &_links[rec.first];
+  index const *const case_handlers = conditions + rec.count;
+  index const default_handler = case_handlers[rec.count];
+
+  status st = status::failure;
+
+  try {
+    if (phase == match_state) {
+      size_t running = {};
+      size_t matched = {};
+
+      for (size_t i = 0; i < rec.count; ++i) {
+        size_t &case_st = match_statuses[i];
+
+        if (to_status(case_st) == status::running)
+          case_st = to_slot(tick(conditions[i], block, depth + 1));
+        if (to_status(case_st) == status::running)
+          ++running;
+        else if (to_status(case_st) == status::success)
+          ++matched;
+      }
+
+      if (running) {
+        st = status::running;
+      } else {
+        if (matched) {
+          // Collect the matched handlers, the same handler is executed once
+          index mapped_handler = npos;
+          for (size_t i = 0; i < rec.count; ++i) {
+            if (to_status(match_statuses[i]) != status::success ||
+                mapped_handler == case_handlers[i])
+              continue;
+            mapped_handler = case_handlers[i];
+            handler_statuses[handlers * 2] = mapped_handler;
+            handler_statuses[handlers * 2 + 1] = to_slot(status::running);
+            ++handlers;
+          }
+
+          std::fill(match_statuses, match_statuses + rec.count, 0);
+        }
+
+        phase = exec_state;
+        st = status::success;
+      }
+    }
+
+    if (phase == exec_state) {
+      if (handlers) { // execute matched handlers
+        size_t running = {};
+        size_t failed = {};
+
+        for (size_t i = 0; i < handlers; ++i) {
+          size_t &handler_st = handler_statuses[i * 2 + 1];
+
+          if (to_status(handler_st) == status::running)
+            handler_st = to_slot(
+                tick(static_cast<index>(handler_statuses[i * 2]), block,
+                     depth + 1));
+          if (to_status(handler_st) == status::running)
+            ++running;
+          if (to_status(handler_st) == status::failure)
+            ++failed;
+        }
+
+        st = running != 0  ? status::running
+             : failed != 0 ? status::failure
+                           : status::success;
+      } else { // execute default handler
+        st = default_handler != npos ? tick(default_handler, block, depth + 1)
+                                     : status::failure;
+      }
+    }
+
+    if (st != status::running)
+      reset(rec, block);
+    else
+      block[_path] = depth + 1;
+  } catch (...) {
+    halt(rec, block);
+    throw;
+  }
+
+  return st;
+}
+
+status flat_tree::tick_decorator(record const &rec, size_t *block,
+                                 size_t depth) const {
+  index const child = _links[rec.first];
+  if (child == npos)
+    throw std::runtime_error("There is no controllable node under the '" +
+                             std::string(to_string(rec.type)) + "' node");
+
+  // repeat and retry with zero repetitions don't tick the child
+  if ((rec.type == node_type::repeat || rec.type == node_type::retry) &&
+      block[rec.state] >= rec.param) {
+    reset(rec, block);
+    return rec.type == node_type::repeat ? status::success : status::failure;
+  }
+
+  status st;
+
+  try {
+    st = tick(child, block, depth + 1);
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return resume_decorator(rec, block, depth, st);
+}
+
+status flat_tree::resume_decorator(record const &rec, size_t *block,
+                                   size_t depth, status st) const {
+  switch (rec.type) {
+  case node_type::invert:
+    return inverted(st);
+  case node_type::force:
+    return st == status::running ? st : to_status(rec.param);
+  case node_type::repeat:
+    return resume_loop(rec, block, depth, st, status::success);
+  case node_type::retry:
+    return resume_loop(rec, block, depth, st, status::failure);
+  default:
+    break;
+  }
+
+  throw std::runtime_error("Unsupported node type");
+}
+
+status flat_tree::resume_loop(record const &rec, size_t *block, size_t depth,
+                              status st, status proceed) const {
+  size_t const step = rec.param == repeat::infinitely ? 0 : 1;
+  size_t &i = block[rec.state];
+
+  try {
+    // repeat proceeds on success and retry proceeds on failure
+    while (st == proceed) {
+      if ((i += step) >= rec.param)
+        break;
+      st = tick(_links[rec.first], block, depth + 1);
+    }
+
+    if (st != status::running)
+      reset(rec, block);
+  } catch (...) {
+    reset(rec, block);
+    throw;
+  }
+
+  return st;
+}
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,139 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief The behavior tree compiled into a linear array of node records.
+ * Records are stored in depth-first order and the children of each record are
+ * referenced by a contiguous range of indices. The tree is ticked by a
+ * non-virtual interpreter and behaves exactly like the source tree.
+ *
+ * The compiled tree is immutable and doesn't hold any execution state, so it
+ * can be shared by many instances. The resumable state of every instance is
+ * kept in a compact state block which is passed into the tick.
+ *
+ * The state block also keeps the active path: the nodes from the root down to
+ * the running leaf, or to the first parallel or switch node on the way. The
+ * next tick resumes the last node of the path directly, and the ancestors are
+ * visited only when it completes.
+ *
+ * Leaf callables are invoked in place, so the source tree must outlive the
+ * compiled one. Custom nodes are not supported.
+ */
+class flat_tree {
+public:
+  using index = std::uint32_t;
+
+  static constexpr auto npos = std::numeric_limits<index>::max();
+
+  /**
+   * @brief Compact node record
+   */
+  struct record {
+    node_type type;
+    index first; // The first child index in the links array
+    index count; // Number of children (cases for switch)
+    index state; // Offset of the node state in the state block
+    size_t param;  // threshold, repetitions count or forced status
+    node const *source;
+  };
+
+  using records_list = std::vector<record>;
+  using links_list = std::vector<index>;
+
+  /**
+   * @brief Per-instance state block
+   */
+  using state = std::vector<size_t>;
+
+  explicit flat_tree(node const &root);
+
+  state make_state() const;
+  status operator()(state &st) const;
+
+  /**
+   * @brief Halt the running nodes of the instance and reset its state
+   */
+  void halt(state &st) const;
+
+  records_list const &records() const;
+  links_list const &links() const;
+  size_t state_size() const;
+
+  /**
+   * @brief Number of state slots used by the node records. The slots of the
+   * active path follow them.
+   */
+  size_t nodes_state_size() const;
+
+  /**
+   * @brief Number of state slots used by the node record
+   */
+  static size_t state_size(record const &rec);
+
+private:
+  index compile(node const &ref, size_t depth);
+  index compile(node::cptr const &ref, size_t depth);
+
+  status tick(index idx, size_t *block, size_t depth) const;
+  status tick_action(record const &rec, size_t *block, size_t depth) const;
+  status tick_chain(record const &rec, size_t *block, size_t depth,
+                    status proceed) const;
+  status tick_parallel(record const &rec, size_t *block, size_t depth) const;
+  status tick_if(record const &rec, size_t *block, size_t depth) const;
+  status tick_switch(record const &rec, size_t *block, size_t depth) const;
+  status tick_decorator(record const &rec, size_t *block, size_t depth) const;
+
+  status resume(size_t *block) const;
+  status resume(record const &rec, size_t *block, size_t depth,
+                status st) const;
+  status resume_chain(record const &rec, size_t *block, size_t depth,
+                      status st, status proceed) const;
+  status resume_if(record const &rec, size_t *block, size_t depth,
+                   status st) const;
+  status resume_decorator(record const &rec, size_t *block, size_t depth,
+                          status st) const;
+  status resume_loop(record const &rec, size_t *block, size_t depth,
+                     status st, status proceed) const;
+
+  void halt(record const &rec, size_t *block) const;
+  void reset(record const &rec, size_t *block) const;
+
+private:
+  records_list _records;
+  links_list _links;
+  size_t _state_size{};
+  size_t _path{};  // Offset of the active path in the state block
+  size_t _depth{}; // Maximum depth of the tree
+};
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,143 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvimage.hpp"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cppttl {
+namespace bhv {
+
+class image::mapping {
+public:
+  explicit mapping(std::string const &path);
+  mapping(mapping const &) = delete;
+  mapping &operator=(mapping const &) = delete;
+  ~mapping();
+
+  char const *data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  char const *_data = nullptr;
+  size_t _size{};
+};
+
+#if defined(_WIN32)
+
+image::mapping::mapping(std::string const &path) {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("Unable to open the image '" + path + "'");
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Unable to get the image size '" + path + "'");
+  }
+
+  _size = static_cast<size_t>(size.QuadPart);
+
+  if (_size != 0) {
+    HANDLE view =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (view)
+      _data = static_cast<char const *>(
+          MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+    if (view)
+      CloseHandle(view);
+  }
+
+  CloseHandle(file);
+
+  if (_size != 0 && !_data)
+    throw std::runtime_error("Unable to map the image '" + path + "'");
+}
+
+image::mapping::~mapping() {
+  if (_data)
+    UnmapViewOfFile(_data);
+}
+
+#else
+
+image::mapping::mapping(std::string const &path) {
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error("Unable to open the image '" + path + "'");
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Unable to get the image size '" + path + "'");
+  }
+
+  _size = static_cast<size_t>(st.st_size);
+
+  if (_size != 0) {
+    void *const ptr = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED)
+      _data = static_cast<char const *>(ptr);
+  }
+
+  // The mapping remains valid after the file is closed
+  ::close(fd);
+
+  if (_size != 0 && !_data)
+    throw std::runtime_error("Unable to map the image '" + path + "'");
+}
+
+image::mapping::~mapping() {
+  if (_data)
+    ::munmap(const_cast<char *>(_data), _size);
+}
+
+#endif
+
+image::image(std::string const &path)
+    : _mapping(std::make_shared<mapping const>(path)) {}
+
+char const *image::data() const { return _mapping->data(); }
+
+size_t image::size() const { return _mapping->size(); }
+
+std::string_view image::view() const { return {data(), size()}; }
+
+node::ptr load(image const &img, registry const &reg) {
+  return load(img.view(), reg, img._mapping);
+}
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,73 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvserializer.hpp"
+#include "bhvtree.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief The read-only memory mapping of a tree image file.
+ * The image is the tree saved in the binary format. The pages of the mapping
+ * are shared by all the processes mapping the same file, and the trees loaded
+ * from the image refer to the node names in place.
+ *
+ * The image is copyable, the copies share the mapping. The mapping is released
+ * with the last copy and the last tree loaded from it.
+ */
+class image {
+public:
+  /**
+   * @brief Map the image file
+   * @throw std::runtime_error if the file can't be mapped
+   */
+  explicit image(std::string const &path);
+
+  char const *data() const;
+  size_t size() const;
+  std::string_view view() const;
+
+private:
+  class mapping;
+
+  std::shared_ptr<mapping const> _mapping;
+
+  friend node::ptr load(image const &img, registry const &reg);
+};
+
+/**
+ * @brief Load the behavior tree from the mapped image without copying
+ *
+ * @param [in]  img     The mapped image
+ * @param [in]  reg     Registry of the leaf handlers
+ * @return node::ptr    Pointer to the loaded tree, it keeps the mapping
+ */
+node::ptr load(image const &img, registry const &reg);
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,223 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvprofiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BHVT_HAS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BHVT_HAS_RDTSC
+#endif
+
+namespace cppttl {
+namespace bhv {
+namespace profiler {
+
+namespace {
+
+using counter = std::atomic<std::uint64_t>;
+
+/**
+ * @brief The counters are written by the owning thread only, the atomics make
+ * them readable by the snapshot without locks on the tick path.
+ */
+struct counters {
+  node_type type = node_type::custom;
+  std::string_view name;
+  counter ticks{0};
+  counter total_time{0};
+  counter max_time{0};
+  std::array<counter, 3> statuses{};
+};
+
+void add(counter &value, std::uint64_t n) {
+  value.store(value.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+}
+
+void load(node_profile &profile, counters const &src) {
+  auto const get = [](counter const &value) {
+    return value.load(std::memory_order_relaxed);
+  };
+
+  profile.ticks += get(src.ticks);
+  profile.total_time += get(src.total_time);
+  profile.max_time = std::max(profile.max_time, get(src.max_time));
+  for (size_t i = 0; i < profile.statuses.size(); ++i)
+    profile.statuses[i] += get(src.statuses[i]);
+}
+
+void clear(counters &src) {
+  src.ticks.store(0, std::memory_order_relaxed);
+  src.total_time.store(0, std::memory_order_relaxed);
+  src.max_time.store(0, std::memory_order_relaxed);
+  for (auto &value : src.statuses)
+    value.store(0, std::memory_order_relaxed);
+}
+
+using merged = std::unordered_map<node const *, node_profile>;
+
+class thread_profile;
+
+/**
+ * @brief The live thread tables and the statistics of the finished threads
+ */
+struct threads {
+  std::mutex mutex;
+  std::vector<thread_profile *> live;
+  merged finished;
+
+  static threads &get() {
+    static threads instance;
+    return instance;
+  }
+};
+
+node_profile &entry(merged &dst, node const *ref, node_type type,
+                    std::string_view name) {
+  auto &profile = dst[ref];
+  profile.source = ref;
+  profile.type = type;
+  profile.name = name;
+  return profile;
+}
+
+class thread_profile {
+public:
+  thread_profile() : _threads(threads::get()) {
+    std::lock_guard<std::mutex> lock(_threads.mutex);
+    _threads.live.push_back(this);
+  }
+
+  ~thread_profile() {
+    std::lock_guard<std::mutex> lock(_threads.mutex);
+    collect(_threads.finished);
+    _threads.live.erase(
+        std::find(_threads.live.begin(), _threads.live.end(), this));
+  }
+
+  counters &get(node const &ref) {
+    // Only the owning thread modifies the table, so the lookup doesn't lock
+    auto it = _table.find(&ref);
+    if (it != _table.end() &&
+        it->second.ticks.load(std::memory_order_relaxed) != 0)
+      return it->second;
+
+    // The address may belong to another node since the reset
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &src = it != _table.end() ? it->second : _table[&ref];
+    src.type = ref.type();
+    src.name = ref.name();
+    return src;
+  }
+
+  void collect(merged &dst) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto const &[ref, src] : _table) {
+      if (src.ticks.load(std::memory_order_relaxed) != 0)
+        load(entry(dst, ref, src.type, src.name), src);
+    }
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &item : _table)
+      clear(item.second);
+  }
+
+private:
+  threads &_threads;
+  std::mutex _mutex;
+  std::unordered_map<node const *, counters> _table;
+};
+
+thread_local thread_profile local_profile;
+
+} // namespace
+
+std::uint64_t now() {
+#ifdef BHVT_HAS_RDTSC
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void record(node const &ref, std::uint64_t time, status const *st) {
+  auto &src = local_profile.get(ref);
+  add(src.ticks, 1);
+  add(src.total_time, time);
+  if (time > src.max_time.load(std::memory_order_relaxed))
+    src.max_time.store(time, std::memory_order_relaxed);
+  // The exceptions and the invalid statuses are counted by the ticks only
+  auto const idx = st ? static_cast<size_t>(*st) : src.statuses.size();
+  if (idx < src.statuses.size())
+    add(src.statuses[idx], 1);
+}
+
+profiles snapshot() {
+  auto &all = threads::get();
+  std::lock_guard<std::mutex> lock(all.mutex);
+
+  merged result;
+  for (auto const &[ref, profile] : all.finished) {
+    auto &dst = entry(result, ref, profile.type, profile.name);
+    dst.ticks += profile.ticks;
+    dst.total_time += profile.total_time;
+    dst.max_time = std::max(dst.max_time, profile.max_time);
+    for (size_t i = 0; i < dst.statuses.size(); ++i)
+      dst.statuses[i] += profile.statuses[i];
+  }
+  for (auto *thread : all.live)
+    thread->collect(result);
+
+  profiles list;
+  list.reserve(result.size());
+  for (auto const &item : result)
+    list.push_back(item.second);
+  std::sort(list.begin(), list.end(),
+            [](auto const &lhs, auto const &rhs) {
+              return lhs.total_time > rhs.total_time;
+            });
+  return list;
+}
+
+void reset() {
+  auto &all = threads::get();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  all.finished.clear();
+  for (auto *thread : all.live)
+    thread->reset();
+}
+
+} // namespace profiler
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,107 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Tick statistics of the node collected by the profiler.
+ * The times are measured in the time stamp counter cycles where it's available
+ * and in nanoseconds otherwise. The times of the control nodes and decorators
+ * include the times of their children.
+ */
+struct node_profile {
+  node const *source = nullptr;
+  node_type type = node_type::custom;
+  std::string_view name;
+  std::uint64_t ticks = 0;
+  std::uint64_t total_time = 0;
+  std::uint64_t max_time = 0;
+  std::array<std::uint64_t, 3> statuses = {}; ///< Indexed by the status
+
+  /**
+   * @brief Number of the ticks completed by the exceptions or by the invalid
+   * statuses
+   */
+  std::uint64_t errors() const {
+    return ticks - statuses[0] - statuses[1] - statuses[2];
+  }
+
+  std::uint64_t count(status st) const {
+    return statuses[static_cast<size_t>(st)];
+  }
+};
+
+/**
+ * @brief Per-node tick profiler.
+ * The node ticks are recorded only if the library is built with the
+ * BHVT_PROFILING option, otherwise the profiler is compiled out and the
+ * snapshot is always empty. Every thread records its ticks into its own table,
+ * the tables are merged on demand.
+ */
+namespace profiler {
+
+#ifdef BHVT_PROFILING
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+using profiles = std::vector<node_profile>;
+
+/**
+ * @brief Merge the statistics of all threads, including the finished ones.
+ * The nodes ticked on several threads are merged into one entry, the entries
+ * are sorted by the total time. The statistics are keyed by the node addresses,
+ * so the profiler should be reset when the profiled trees are destroyed.
+ * The names are views of the node names, so the nodes must be alive to read
+ * them.
+ */
+profiles snapshot();
+
+/**
+ * @brief Reset the statistics of all threads
+ */
+void reset();
+
+/**
+ * @brief Current value of the profiler clock
+ */
+std::uint64_t now();
+
+/**
+ * @brief Record the node tick completed with the status or with the exception
+ * (st is nullptr). Called by node::operator().
+ */
+void record(node const &ref, std::uint64_t time, status const *st);
+
+} // namespace profiler
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,275 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvscheduler.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace cppttl {
+namespace bhv {
+
+scheduler::scheduler(executor &ex, size_t grain)
+    : _executor(ex), _grain(grain ? grain : 1) {}
+
+scheduler::instance scheduler::allocate(size_t period) {
+  instance id;
+  if (!_free.empty()) {
+    id = _free.back();
+    _free.pop_back();
+  } else {
+    _slots.emplace_back();
+    id = _slots.size() - 1;
+  }
+
+  auto &s = _slots[id];
+  s.used = true;
+  s.period = std::max<size_t>(period, 1);
+  s.ticked = 0;
+  return id;
+}
+
+scheduler::slot &scheduler::get(instance id) {
+  if (id >= _slots.size() || !_slots[id].used)
+    throw std::runtime_error("Invalid scheduler instance");
+  return _slots[id];
+}
+
+scheduler::slot const &scheduler::get(instance id) const {
+  if (id >= _slots.size() || !_slots[id].used)
+    throw std::runtime_error("Invalid scheduler instance");
+  return _slots[id];
+}
+
+scheduler::instance scheduler::add(node::ptr root, size_t period) {
+  if (!root)
+    throw std::runtime_error("The scheduled tree is empty");
+
+  instance const id = allocate(period);
+  _slots[id].root = std::move(root);
+  enqueue(id);
+  return id;
+}
+
+scheduler::instance scheduler::add(flat_tree const &tree, size_t period) {
+  auto state = tree.make_state();
+
+  instance const id = allocate(period);
+  _slots[id].tree = &tree;
+  _slots[id].state = std::move(state);
+  enqueue(id);
+  return id;
+}
+
+void scheduler::remove(instance id) {
+  auto &s = get(id);
+  if (s.tree)
+    s.tree->halt(s.state);
+  else
+    s.root->halt();
+
+  // The ticket survives the reuse of the slot, so the queued entries of the
+  // removed instance stay invalid
+  detach(id);
+  size_t const ticket = s.ticket + 1;
+  s = slot{};
+  s.ticket = ticket;
+  _free.push_back(id);
+}
+
+status scheduler::last(instance id) const { return get(id).last; }
+
+void scheduler::set_period(instance id, size_t period) {
+  auto &s = get(id);
+  s.period = std::max<size_t>(period, 1);
+  enqueue(id);
+}
+
+size_t scheduler::period(instance id) const { return get(id).period; }
+
+void scheduler::set_frame_limit(size_t instances) { _limit = instances; }
+
+void scheduler::on_lod(lod_handler fn) { _on_lod = std::move(fn); }
+
+size_t scheduler::size() const { return _slots.size() - _free.size(); }
+
+size_t scheduler::frames() const { return _frames; }
+
+void scheduler::on_frame(frame_handler fn) { _on_frame = std::move(fn); }
+
+void scheduler::enqueue(instance id) {
+  auto &s = _slots[id];
+  ++s.ticket;
+  if (s.period == 1) {
+    if (s.position == slot::npos) {
+      _every_frame.push_back(id);
+      s.position = _every_frame.size() - 1;
+    }
+    return;
+  }
+
+  detach(id);
+
+  // The new instances are spread over the period, the ticked ones keep their
+  // phase
+  size_t const next = _frames + 1;
+  size_t const due = s.ticked ? std::max(next, s.ticked + s.period)
+                              : next + _spread++ % s.period;
+  _queue.push({due, id, s.ticket});
+}
+
+void scheduler::detach(instance id) {
+  auto &s = _slots[id];
+  if (s.position == slot::npos)
+    return;
+
+  // The last instance takes the place of the detached one
+  instance const moved = _every_frame.back();
+  _every_frame[s.position] = moved;
+  _slots[moved].position = s.position;
+  _every_frame.pop_back();
+  s.position = slot::npos;
+}
+
+void scheduler::collect(size_t frame) {
+  _due.assign(_every_frame.begin(), _every_frame.end());
+
+  for (size_t n = 0;
+       n < _limit && !_queue.empty() && _queue.top().due <= frame;) {
+    auto const item = _queue.top();
+    _queue.pop();
+
+    auto const &s = _slots[item.id];
+    if (s.used && s.ticket == item.ticket) {
+      _due.push_back(item.id);
+      ++n;
+    }
+  }
+}
+
+void scheduler::reschedule(size_t frame) {
+  for (instance id : _due) {
+    auto &s = _slots[id];
+    s.ticked = frame;
+
+    size_t period = s.period;
+    if (_on_lod)
+      period = std::max<size_t>(_on_lod(id, s.last, period), 1);
+
+    if (period != s.period || period != 1) {
+      s.period = period;
+      enqueue(id);
+    }
+  }
+}
+
+void scheduler::run_chunk(size_t first, size_t last) {
+  for (size_t i = first; i < last; ++i) {
+    auto &s = _slots[_due[i]];
+
+    try {
+      s.last = s.tree ? (*s.tree)(s.state) : (*s.root)();
+    } catch (...) {
+      s.last = status::failure;
+      if (!_error.exchange(true))
+        _exception = std::current_exception();
+    }
+  }
+}
+
+void scheduler::tick() {
+  _error.store(false, std::memory_order_relaxed);
+  _exception = nullptr;
+
+  size_t const frame = _frames + 1;
+  collect(frame);
+
+  size_t const count = _due.size();
+  size_t const chunks = (count + _grain - 1) / _grain;
+
+  if (chunks) {
+    // The last chunk is ticked on the calling thread
+    for (size_t c = 0; c + 1 < chunks; ++c) {
+      size_t const first = c * _grain;
+      size_t const last = first + _grain;
+
+      _pending.fetch_add(1, std::memory_order_relaxed);
+      try {
+        _executor.submit([this, first, last] {
+          run_chunk(first, last);
+          _pending.fetch_sub(1, std::memory_order_release);
+        });
+      } catch (...) {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        run_chunk(first, last);
+      }
+    }
+
+    run_chunk((chunks - 1) * _grain, count);
+
+    while (_pending.load(std::memory_order_acquire) != 0) {
+      if (!_executor.run_one())
+        std::this_thread::yield();
+    }
+  }
+
+  reschedule(frame);
+
+  _frames = frame;
+  if (_on_frame)
+    _on_frame(_frames);
+
+  if (_exception)
+    std::rethrow_exception(std::exchange(_exception, nullptr));
+}
+
+void scheduler::run(std::chrono::nanoseconds period, size_t frames) {
+  using clock = std::chrono::steady_clock;
+
+  // The stop request is consumed when the loop returns, so the request made
+  // before the loop starts isn't lost
+  auto next = clock::now();
+  try {
+    for (size_t i = 0; i < frames && !_stop.load(std::memory_order_relaxed);
+         ++i) {
+      tick();
+
+      next += period;
+      auto const now = clock::now();
+      if (next <= now)
+        next = now;
+      else if (i + 1 < frames && !_stop.load(std::memory_order_relaxed))
+        std::this_thread::sleep_until(next);
+    }
+  } catch (...) {
+    _stop.store(false, std::memory_order_relaxed);
+    throw;
+  }
+
+  _stop.store(false, std::memory_order_relaxed);
+}
+
+void scheduler::stop() { _stop.store(true, std::memory_order_relaxed); }
+
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,223 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvexecutor.hpp"
+#include "bhvflat.hpp"
+#include "bhvtree.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief The scheduler owns many tree instances and ticks all of them once per
+ * frame on the executor.
+ *
+ * The instances are split into chunks of consecutive instances, every chunk is
+ * ticked by a single task, so an instance is never ticked concurrently and all
+ * the ticks of the frame complete before the next frame starts. With the
+ * thread_pool the tasks are distributed over the per-worker queues and the idle
+ * workers steal them. The calling thread helps to execute the tasks while
+ * waiting for the frame completion.
+ *
+ * Every instance is ticked once per its period in frames. The instances ticked
+ * every frame are kept in a dense list, so the frame doesn't visit the other
+ * instances. The instances with the longer periods are kept in the priority
+ * queue ordered by the frames they are due, their phases are spread over the
+ * period, so every frame ticks only a part of them. The number of such
+ * instances ticked per frame can be limited, the instances left over are
+ * ticked first on the next frames.
+ */
+class scheduler {
+public:
+  using instance = size_t;
+  using frame_handler = inplace_function<void(size_t)>;
+
+  /**
+   * @brief The handler called after the frame for every ticked instance with
+   * its status and period. It returns the new period of the instance, so the
+   * instances can be promoted or demoted.
+   */
+  using lod_handler = inplace_function<size_t(instance, status, size_t)>;
+
+  static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+  /**
+   * @param [in] ex     The executor ticking the instances
+   * @param [in] grain  Number of the instances ticked by a single task
+   */
+  explicit scheduler(executor &ex, size_t grain = 64);
+
+  scheduler(scheduler const &) = delete;
+  scheduler &operator=(scheduler const &) = delete;
+
+  /**
+   * @brief Add the instance of the dynamic tree ticked every period frames
+   */
+  instance add(node::ptr root, size_t period = 1);
+
+  /**
+   * @brief Add the instance of the flat tree with its own state.
+   * The flat tree must outlive the scheduler.
+   */
+  instance add(flat_tree const &tree, size_t period = 1);
+
+  /**
+   * @brief Remove the instance between the frames. The running nodes of the
+   * instance are halted.
+   */
+  void remove(instance id);
+
+  /**
+   * @brief The status returned by the last tick of the instance
+   */
+  status last(instance id) const;
+
+  /**
+   * @brief Promote or demote the instance between the frames.
+   * The instance is ticked every period frames, the period 1 is every frame.
+   */
+  void set_period(instance id, size_t period);
+  size_t period(instance id) const;
+
+  /**
+   * @brief Limit the number of the instances with the periods longer than one
+   * frame ticked per frame. The instances ticked every frame aren't limited.
+   */
+  void set_frame_limit(size_t instances);
+
+  /**
+   * @brief Set the handler deciding the periods of the ticked instances.
+   * It's called on the thread ticking the frames after the frame completion.
+   */
+  void on_lod(lod_handler fn);
+
+  /**
+   * @brief Number of the instances
+   */
+  size_t size() const;
+
+  /**
+   * @brief Number of the completed frames
+   */
+  size_t frames() const;
+
+  /**
+   * @brief Set the handler called after each completed frame
+   */
+  void on_frame(frame_handler fn);
+
+  /**
+   * @brief Tick all the instances once and wait for the completion.
+   * The exceptions of the instances don't stop the frame, the status of the
+   * instance becomes failure and the first exception is rethrown after the
+   * frame completion.
+   */
+  void tick();
+
+  /**
+   * @brief Tick the frames at the target frequency until the number of frames
+   * is reached or the scheduler is stopped. The frames overrunning the period
+   * delay the next frames, the missed frames aren't caught up.
+   */
+  void run(std::chrono::nanoseconds period,
+           size_t frames = std::numeric_limits<size_t>::max());
+
+  /**
+   * @brief Stop the running frames loop after the current frame. It can be
+   * called from any thread and from the frame handler. The request made while
+   * the loop isn't running stops the next run() before its first frame.
+   */
+  void stop();
+
+private:
+  struct slot {
+    node::ptr root;
+    flat_tree const *tree = nullptr;
+    flat_tree::state state;
+    status last = status::success;
+    bool used = false;
+    size_t period = 1;
+    size_t ticked = 0; // The last frame the instance was ticked
+    size_t ticket = 0; // Invalidates the queued entries of the instance
+    size_t position = npos; // Position in the list of every frame instances
+
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+  };
+
+  /**
+   * @brief The queued instance, it's valid while the ticket of the instance
+   * is the same
+   */
+  struct entry {
+    size_t due;
+    instance id;
+    size_t ticket;
+
+    bool operator>(entry const &rhs) const {
+      return due != rhs.due ? due > rhs.due : id > rhs.id;
+    }
+  };
+
+  using queue = std::priority_queue<entry, std::vector<entry>,
+                                    std::greater<entry>>;
+
+  instance allocate(size_t period);
+  slot &get(instance id);
+  slot const &get(instance id) const;
+  void enqueue(instance id);
+  void detach(instance id);
+  void collect(size_t frame);
+  void reschedule(size_t frame);
+  void run_chunk(size_t first, size_t last);
+
+private:
+  executor &_executor;
+  size_t const _grain;
+  std::vector<slot> _slots;
+  std::vector<instance> _free;
+  queue _queue;
+  std::vector<instance> _every_frame; // The instances with the period 1
+  std::vector<instance> _due; // The instances of the current frame
+  size_t _limit = unlimited;
+  size_t _spread{};
+  size_t _frames{};
+  frame_handler _on_frame;
+  lod_handler _on_lod;
+  std::atomic<bool> _stop{};
+
+  // The state of the current frame
+  std::atomic<size_t> _pending{};
+  std::atomic<bool> _error{};
+  std::exception_ptr _exception;
+};
+
+} // namespace bhv
+} // namespace cppttl
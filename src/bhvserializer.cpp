@@ -22,300 +22,1196 @@
 
 #include "bhvserializer.hpp"
 #include "bhvtree.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace cppttl {
 namespace bhv {
 namespace {
-using namespace std::string_literals;
-
 namespace lex {
-static const auto none = "none"s;
-static const auto pred = "pred"s;
-static const auto then_ = "then"s;
-static const auto else_ = "else"s;
-static const auto case_ = "case"s;
-static const auto default_ = "default"s;
-static const auto body = "body"s;
+constexpr std::string_view none = "none";
+constexpr std::string_view item = "- ";
+constexpr std::string_view pred = "pred: ";
+constexpr std::string_view then_ = "then: ";
+constexpr std::string_view else_ = "else: ";
+constexpr std::string_view case_ = "- case: ";
+constexpr std::string_view default_ = "- default: ";
+constexpr std::string_view body = "body: ";
 } // namespace lex
 
-const char *type_name(node const &n) { return to_string(n.type()); }
-
-std::string mask(std::string const &str) {
-  auto it = str.find('"');
-  if (it == std::string::npos)
-    return str;
-
-  std::string res;
-  res.reserve(str.size() + 8);
-
-  std::string::size_type p = 0;
-
-  for (; it != std::string::npos; it = str.find('"', it)) {
-    res += str.substr(p, it - p);
-    res += '\\';
-    p = it;
-    it += 1;
-  }
-
-  res += str.substr(p);
-
-  return res;
-}
-
-std::string node_name(node const &n) {
-  return "\""s + mask(std::string(n.name())) + "\""s;
-}
-
+// The text serializer appends the lines to the character buffer. If the stream
+// is specified, the buffer is written into it in large blocks.
 class serializer final {
 public:
-  serializer(std::ostream &stream);
+  serializer(std::string &buffer, std::ostream *stream = nullptr);
+  ~serializer();
 
   serializer &operator<<(node const &ref);
 
 private:
-  std::ostream &indent(size_t layer) const;
-  void save(basic_control::childs_list const &list, size_t layer) const;
-  void save(node const &ref, size_t layer, std::string_view prefix = "") const;
-  void save(action const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(condition const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(sequence const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(fallback const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(parallel const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(if_ const &ref, size_t layer, std::string_view prefix = "") const;
-  void save(switch_ const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(invert const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(repeat const &ref, size_t layer,
-            std::string_view prefix = "") const;
-  void save(retry const &ref, size_t layer, std::string_view prefix = "") const;
-  void save(force const &ref, size_t layer, std::string_view prefix = "") const;
+  void indent(size_t layer);
+  void header(node const &ref, size_t layer, std::string_view prefix);
+  void name(node const &ref);
+  void param(std::string_view key, size_t value);
+  void end_line();
+  void flush();
+
+  void save(node const &ref, size_t layer, std::string_view prefix = {});
+  void save(basic_control::childs_list const &list, size_t layer);
+  void save_control(basic_control const &ref, size_t layer);
+  void save_decorator(basic_control const &ref, size_t layer);
+  void save(if_ const &ref, size_t layer);
+  void save(switch_ const &ref, size_t layer);
 
 private:
-  std::ostream &_stream;
+  static constexpr size_t block_size = 64 * 1024;
+
+  std::string &_buffer;
+  std::ostream *_stream;
+  bool _inline = false; // The node continues the current line
 };
 
-serializer::serializer(std::ostream &stream) : _stream(stream) {}
+serializer::serializer(std::string &buffer, std::ostream *stream)
+    : _buffer(buffer), _stream(stream) {}
+
+serializer::~serializer() {
+  try {
+    flush();
+  } catch (...) {
+  }
+}
 
 serializer &serializer::operator<<(node const &ref) {
   save(ref, 0);
+  flush();
   return *this;
 }
 
-std::ostream &serializer::indent(size_t layer) const {
-  static const char *spaces = "  ";
-  for (size_t i = 0; i < layer; ++i) {
-    _stream << spaces;
+void serializer::indent(size_t layer) {
+  if (std::exchange(_inline, false))
+    return;
+  _buffer.append(layer * 2, ' ');
+}
+
+void serializer::header(node const &ref, size_t layer,
+                        std::string_view prefix) {
+  indent(layer);
+  _buffer += prefix;
+  _buffer += to_string(ref.type());
+  _buffer += ' ';
+}
+
+// The quotes inside the names are escaped
+void serializer::name(node const &ref) {
+  auto const str = ref.name();
+
+  _buffer += '"';
+  for (size_t p = 0;;) {
+    size_t const quote = str.find('"', p);
+    _buffer.append(str, p, quote - p);
+    if (quote == std::string_view::npos)
+      break;
+    _buffer += "\\\"";
+    p = quote + 1;
   }
-  return _stream;
+  _buffer += '"';
 }
 
-void serializer::save(basic_control::childs_list const &list,
-                      size_t layer) const {
-  for (auto &child : list)
-    save(*child, layer, "- ");
+void serializer::param(std::string_view key, size_t value) {
+  char digits[24];
+  auto const res = std::to_chars(std::begin(digits), std::end(digits), value);
+
+  _buffer += key;
+  _buffer += '=';
+  _buffer.append(digits, res.ptr);
+  _buffer += ' ';
 }
 
-void serializer::save(node const &ref, size_t layer,
-                      std::string_view prefix) const {
+void serializer::end_line() {
+  _buffer += '\n';
+  if (_stream && _buffer.size() >= block_size)
+    flush();
+}
+
+void serializer::flush() {
+  if (!_stream || _buffer.empty())
+    return;
+  _stream->write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+  _buffer.clear();
+}
+
+void serializer::save(node const &ref, size_t layer, std::string_view prefix) {
+  header(ref, layer, prefix);
+
   switch (ref.type()) {
   case node_type::action:
-    save(static_cast<action const &>(ref), layer, prefix);
-    break;
   case node_type::condition:
-    save(static_cast<condition const &>(ref), layer, prefix);
+    name(ref);
+    end_line();
     break;
   case node_type::sequence:
-    save(static_cast<sequence const &>(ref), layer, prefix);
-    break;
   case node_type::fallback:
-    save(static_cast<fallback const &>(ref), layer, prefix);
+    name(ref);
+    save_control(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::parallel:
-    save(static_cast<parallel const &>(ref), layer, prefix);
+    param("threshold", static_cast<parallel const &>(ref).threshold());
+    name(ref);
+    save_control(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::if_:
-    save(static_cast<if_ const &>(ref), layer, prefix);
+    name(ref);
+    save(static_cast<if_ const &>(ref), layer);
     break;
   case node_type::switch_:
-    save(static_cast<switch_ const &>(ref), layer, prefix);
+    name(ref);
+    save(static_cast<switch_ const &>(ref), layer);
     break;
   case node_type::invert:
-    save(static_cast<invert const &>(ref), layer, prefix);
+  case node_type::reactive:
+    name(ref);
+    save_decorator(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::repeat:
-    save(static_cast<repeat const &>(ref), layer, prefix);
+    param("n", static_cast<repeat const &>(ref).count());
+    name(ref);
+    save_decorator(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::retry:
-    save(static_cast<retry const &>(ref), layer, prefix);
+    param("n", static_cast<retry const &>(ref).count());
+    name(ref);
+    save_decorator(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::force:
-    save(static_cast<force const &>(ref), layer, prefix);
+    _buffer += "status=";
+    _buffer += to_string(static_cast<force const &>(ref).result());
+    _buffer += ' ';
+    name(ref);
+    save_decorator(static_cast<basic_control const &>(ref), layer);
     break;
   case node_type::custom:
     throw std::runtime_error("Unsupported node type");
-    break;
   }
 }
 
-void serializer::save(action const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref)
-                << std::endl;
-}
-
-void serializer::save(condition const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref)
-                << std::endl;
+void serializer::save(basic_control::childs_list const &list, size_t layer) {
+  for (auto &child : list)
+    save(*child, layer, lex::item);
 }
 
-void serializer::save(sequence const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref) << ":";
+void serializer::save_control(basic_control const &ref, size_t layer) {
+  _buffer += ':';
 
   if (!ref.childs().empty()) {
-    _stream << std::endl;
+    end_line();
     save(ref.childs(), layer + 1);
   } else {
-    _stream << " " << lex::none << std::endl;
+    _buffer += ' ';
+    _buffer += lex::none;
+    end_line();
   }
 }
 
-void serializer::save(fallback const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref) << ":";
+// The child of a decorator continues the decorator line, and its children are
+// indented relative to the decorator
+void serializer::save_decorator(basic_control const &ref, size_t layer) {
+  _buffer += ": ";
 
   if (!ref.childs().empty()) {
-    _stream << std::endl;
-    save(ref.childs(), layer + 1);
+    _inline = true;
+    save(*ref.childs().front(), layer);
   } else {
-    _stream << " " << lex::none << std::endl;
+    _buffer += lex::none;
+    end_line();
   }
 }
 
-void serializer::save(parallel const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " threshold=" << ref.threshold()
-                << " " << node_name(ref) << ":";
+void serializer::save(if_ const &ref, size_t layer) {
+  _buffer += ':';
 
   if (!ref.childs().empty()) {
-    _stream << std::endl;
-    save(ref.childs(), layer + 1);
-  } else {
-    _stream << " " << lex::none << std::endl;
-  }
-}
-
-void serializer::save(if_ const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref) << ":";
-
-  if (!ref.childs().empty()) {
-    _stream << std::endl;
+    end_line();
 
     if (ref.condition()) {
-      save(*ref.condition(), layer + 1, lex::pred + ": ");
+      save(*ref.condition(), layer + 1, lex::pred);
     }
     if (ref.then_()) {
-      save(*ref.then_(), layer + 1, lex::then_ + ": ");
+      save(*ref.then_(), layer + 1, lex::then_);
     }
     if (ref.else_()) {
-      save(*ref.else_(), layer + 1, lex::else_ + ": ");
+      save(*ref.else_(), layer + 1, lex::else_);
     }
   } else {
-    _stream << " " << lex::none << std::endl;
+    _buffer += ' ';
+    _buffer += lex::none;
+    end_line();
   }
 }
 
-void serializer::save(switch_ const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref) << ":";
+void serializer::save(switch_ const &ref, size_t layer) {
+  _buffer += ':';
 
   if (!ref.empty()) {
-    _stream << std::endl;
+    end_line();
 
     node::cptr handler;
 
     for (auto &&case_ : ref) {
       if (handler && handler != case_.handler())
-        save(*handler, layer + 2, lex::body + ": ");
-      save(*case_.condition(), layer + 1, "- " + lex::case_ + ": ");
+        save(*handler, layer + 2, lex::body);
+      save(*case_.condition(), layer + 1, lex::case_);
       handler = case_.handler();
     }
 
     if (handler)
-      save(*handler, layer + 2, lex::body + ": ");
+      save(*handler, layer + 2, lex::body);
 
     if (ref.default_handler()) {
-      save(*ref.default_handler(), layer + 1, "- " + lex::default_ + ": ");
+      save(*ref.default_handler(), layer + 1, lex::default_);
     }
   } else {
-    _stream << " " << lex::none << std::endl;
+    _buffer += ' ';
+    _buffer += lex::none;
+    end_line();
   }
 }
 
-void serializer::save(invert const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " " << node_name(ref) << ": ";
+// Binary format:
+//   header: magic, version
+//   names:  count, length[count], characters
+//   tree:   nodes in depth-first order
+//
+// Every node starts with the tag (node type + 1 or none for the missing node)
+// and the name index. The parameters and the children follow:
+//   sequence, fallback: count, childs[count]
+//   parallel:           threshold, count, childs[count]
+//   if:                 condition, then, else
+//   switch:             keyed, groups, {cases, case[cases], handler}[groups],
+//                       default. The keyed cases are stored as values.
+//   invert, reactive:   child
+//   repeat, retry:      count, child
+//   force:              status, child
+// The integers are stored as LEB128 varints, the keys are zigzag encoded.
+namespace binary {
+static char const magic[] = {'B', 'H', 'V', 'T'};
+static std::uint64_t const version = 1;
+static std::uint8_t const none = 0;
+} // namespace binary
 
-  if (!ref.childs().empty()) {
-    save(*ref.childs().front(), 0);
-  } else {
-    _stream << lex::none << std::endl;
+class binary_writer final {
+public:
+  binary_writer(std::string &buffer, std::ostream *stream = nullptr);
+
+  binary_writer &operator<<(node const &ref);
+
+private:
+  void collect(node const *ref);
+  void collect(basic_control::childs_list const &list);
+  void add_name(std::string_view name);
+
+  void save(node const *ref);
+  void save(basic_control::childs_list const &list);
+  void save(switch_ const &ref);
+  void save_decorator(node const &ref);
+
+  void put(std::uint8_t byte);
+  void put_varint(std::uint64_t value);
+  void put_key(switch_key value);
+
+private:
+  std::string &_buffer;
+  std::ostream *_stream;
+  std::vector<std::string_view> _names;
+  std::unordered_map<std::string_view, size_t> _indices;
+};
+
+binary_writer::binary_writer(std::string &buffer, std::ostream *stream)
+    : _buffer(buffer), _stream(stream) {}
+
+binary_writer &binary_writer::operator<<(node const &ref) {
+  collect(&ref);
+
+  _buffer.append(binary::magic, sizeof binary::magic);
+  put_varint(binary::version);
+
+  put_varint(_names.size());
+  for (auto name : _names)
+    put_varint(name.size());
+  for (auto name : _names)
+    _buffer.append(name.data(), name.size());
+
+  save(&ref);
+
+  if (_stream) {
+    _stream->write(_buffer.data(),
+                   static_cast<std::streamsize>(_buffer.size()));
+    _buffer.clear();
   }
+
+  return *this;
 }
 
-void serializer::save(repeat const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " n=" << ref.count() << " "
-                << node_name(ref) << ": ";
+void binary_writer::collect(node const *ref) {
+  if (!ref)
+    return;
 
-  if (!ref.childs().empty()) {
-    save(*ref.childs().front(), 0);
-  } else {
-    _stream << lex::none << std::endl;
+  add_name(ref->name());
+
+  switch (ref->type()) {
+  case node_type::action:
+  case node_type::condition:
+    break;
+  case node_type::sequence:
+  case node_type::fallback:
+  case node_type::parallel:
+  case node_type::if_:
+  case node_type::invert:
+  case node_type::repeat:
+  case node_type::retry:
+  case node_type::force:
+  case node_type::reactive:
+    collect(static_cast<basic_control const *>(ref)->childs());
+    break;
+  case node_type::switch_: {
+    auto const &stmt = static_cast<switch_ const &>(*ref);
+    for (auto &&case_ : stmt) {
+      if (!stmt.keyed())
+        collect(case_.condition().get());
+      collect(case_.handler().get());
+    }
+    collect(stmt.default_handler().get());
+    break;
+  }
+  case node_type::custom:
+    throw std::runtime_error("Unsupported node type");
+  }
+}
+
+void binary_writer::collect(basic_control::childs_list const &list) {
+  for (auto &child : list)
+    collect(child.get());
+}
+
+void binary_writer::add_name(std::string_view name) {
+  if (_indices.emplace(name, _names.size()).second)
+    _names.emplace_back(name);
+}
+
+void binary_writer::save(node const *ref) {
+  if (!ref) {
+    put(binary::none);
+    return;
+  }
+
+  put(static_cast<std::uint8_t>(static_cast<size_t>(ref->type()) + 1));
+  put_varint(_indices.at(ref->name()));
+
+  switch (ref->type()) {
+  case node_type::action:
+  case node_type::condition:
+    break;
+  case node_type::sequence:
+  case node_type::fallback:
+    save(static_cast<basic_control const *>(ref)->childs());
+    break;
+  case node_type::parallel:
+    put_varint(static_cast<parallel const *>(ref)->threshold());
+    save(static_cast<parallel const *>(ref)->childs());
+    break;
+  case node_type::if_: {
+    auto const &stmt = static_cast<if_ const &>(*ref);
+    save(stmt.condition().get());
+    save(stmt.then_().get());
+    save(stmt.else_().get());
+    break;
+  }
+  case node_type::switch_:
+    save(static_cast<switch_ const &>(*ref));
+    break;
+  case node_type::repeat:
+    put_varint(static_cast<repeat const *>(ref)->count());
+    save_decorator(*ref);
+    break;
+  case node_type::retry:
+    put_varint(static_cast<retry const *>(ref)->count());
+    save_decorator(*ref);
+    break;
+  case node_type::force:
+    put(static_cast<std::uint8_t>(static_cast<force const *>(ref)->result()));
+    save_decorator(*ref);
+    break;
+  case node_type::invert:
+  case node_type::reactive:
+    save_decorator(*ref);
+    break;
+  case node_type::custom:
+    throw std::runtime_error("Unsupported node type");
   }
 }
 
-void serializer::save(retry const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref) << " n=" << ref.count() << " "
-                << node_name(ref) << ": ";
+void binary_writer::save(basic_control::childs_list const &list) {
+  put_varint(list.size());
+  for (auto &child : list)
+    save(child.get());
+}
 
-  if (!ref.childs().empty()) {
-    save(*ref.childs().front(), 0);
-  } else {
-    _stream << lex::none << std::endl;
+void binary_writer::save(switch_ const &ref) {
+  put(ref.keyed() ? 1 : 0);
+
+  // The cases are grouped by the handlers
+  size_t groups = {};
+  node::cptr handler;
+  for (auto &&case_ : ref) {
+    if (groups == 0 || handler != case_.handler())
+      ++groups;
+    handler = case_.handler();
   }
+
+  put_varint(groups);
+
+  auto it = ref.begin();
+  for (size_t n = 0, i = 0; n < groups; ++n) {
+    handler = (*it).handler();
+
+    auto first = it;
+    size_t cases = {};
+    for (; it != ref.end() && (*it).handler() == handler; ++it)
+      ++cases;
+
+    put_varint(cases);
+    for (; first != it; ++first, ++i) {
+      if (ref.keyed())
+        put_key(ref.keys()[i]);
+      else
+        save((*first).condition().get());
+    }
+
+    save(handler.get());
+  }
+
+  save(ref.default_handler().get());
 }
 
-void serializer::save(force const &ref, size_t layer,
-                      std::string_view prefix) const {
-  indent(layer) << prefix << type_name(ref)
-                << " status=" << to_string(ref.result()) << " "
-                << node_name(ref) << ": ";
+void binary_writer::save_decorator(node const &ref) {
+  auto const &childs = static_cast<basic_control const &>(ref).childs();
+  save(childs.empty() ? nullptr : childs.front().get());
+}
 
-  if (!ref.childs().empty()) {
-    save(*ref.childs().front(), 0);
+void binary_writer::put(std::uint8_t byte) {
+  _buffer.push_back(static_cast<char>(byte));
+}
+
+void binary_writer::put_varint(std::uint64_t value) {
+  for (; value >= 0x80; value >>= 7)
+    put(static_cast<std::uint8_t>(value | 0x80));
+  put(static_cast<std::uint8_t>(value));
+}
+
+void binary_writer::put_key(switch_key value) {
+  auto const bits = static_cast<std::uint64_t>(value);
+  put_varint((bits << 1) ^ (value < 0 ? ~std::uint64_t{} : std::uint64_t{}));
+}
+
+// The loaded tree owns the storage of the node names or the image the names
+// refer to
+struct loaded_tree {
+  std::pmr::monotonic_buffer_resource names{get_memory_resource()};
+  std::shared_ptr<void const> image;
+  node::ptr root;
+
+  char *allocate(size_t size) {
+    return static_cast<char *>(names.allocate(size, 1));
+  }
+};
+
+node::ptr make_root(std::shared_ptr<loaded_tree> const &tree) {
+  if (!tree->root)
+    throw std::runtime_error("There is no root node in the stream");
+  return node::ptr(tree, tree->root.get());
+}
+
+// The binary format reader. The stream is read sequentially and the names are
+// copied into the tree, while the names of the image in memory are referenced
+// in place.
+class binary_reader final {
+public:
+  binary_reader(std::istream &stream, registry const &reg);
+  binary_reader(std::string_view image, registry const &reg,
+                std::shared_ptr<void const> owner);
+
+  node::ptr load();
+
+private:
+  node::ptr load_node(size_t depth);
+  node::ptr load_switch(std::string_view name, size_t depth);
+  template <typename Control>
+  node::ptr load_control(Control &&ref, size_t depth);
+  template <typename Decorator>
+  node::ptr load_decorator(Decorator &&ref, size_t depth);
+
+  std::uint8_t get();
+  char const *get_chars(size_t size);
+  std::uint64_t get_varint();
+  size_t get_size();
+  switch_key get_key();
+  std::string_view get_name();
+
+private:
+  using names_list = std::vector<std::string_view, allocator<std::string_view>>;
+
+  std::streambuf *_stream = nullptr;
+  std::string_view _image;
+  std::shared_ptr<void const> _owner;
+  registry const &_registry;
+  std::shared_ptr<loaded_tree> _tree;
+  names_list _names;
+};
+
+binary_reader::binary_reader(std::istream &stream, registry const &reg)
+    : _stream(stream.rdbuf()), _registry(reg) {}
+
+binary_reader::binary_reader(std::string_view image, registry const &reg,
+                             std::shared_ptr<void const> owner)
+    : _image(image), _owner(std::move(owner)), _registry(reg) {}
+
+node::ptr binary_reader::load() {
+  char magic[sizeof binary::magic];
+  for (auto &ch : magic)
+    ch = static_cast<char>(get());
+  if (!std::equal(std::begin(magic), std::end(magic),
+                  std::begin(binary::magic)) ||
+      get_varint() != binary::version)
+    throw std::runtime_error("Unsupported binary format");
+
+  _tree = std::allocate_shared<loaded_tree>(allocator<loaded_tree>());
+  _tree->image = std::move(_owner);
+
+  size_t const count = get_size();
+  size_t length = {};
+  for (size_t i = 0; i < count; ++i) {
+    size_t const size = get_size();
+    _names.emplace_back(nullptr, size);
+    length += size;
+  }
+
+  char const *ptr = get_chars(length);
+  for (auto &name : _names) {
+    name = std::string_view(ptr, name.size());
+    ptr += name.size();
+  }
+
+  _tree->root = load_node(1);
+
+  return make_root(_tree);
+}
+
+node::ptr binary_reader::load_node(size_t depth) {
+  std::uint8_t const tag = get();
+  if (tag == binary::none)
+    return {};
+
+  if (depth > max_load_depth)
+    throw std::runtime_error("The tree is nested too deeply");
+
+  auto const type = static_cast<node_type>(tag - 1);
+  auto const name = get_name();
+
+  switch (type) {
+  case node_type::action:
+    return _registry.make_action(name);
+  case node_type::condition:
+    return _registry.make_condition(name);
+  case node_type::sequence:
+    return load_control(sequence(name), depth);
+  case node_type::fallback:
+    return load_control(fallback(name), depth);
+  case node_type::parallel:
+    return load_control(parallel(name, get_size()), depth);
+  case node_type::if_: {
+    auto stmt = make_node<if_>(name);
+    stmt->condition(load_node(depth + 1));
+    stmt->then_(load_node(depth + 1));
+    stmt->else_(load_node(depth + 1));
+    return stmt;
+  }
+  case node_type::switch_:
+    return load_switch(name, depth);
+  case node_type::invert:
+    return load_decorator(invert(name), depth);
+  case node_type::repeat:
+    return load_decorator(repeat(name, get_size()), depth);
+  case node_type::retry:
+    return load_decorator(retry(name, get_size()), depth);
+  case node_type::force: {
+    auto const st = get();
+    if (st > static_cast<std::uint8_t>(status::failure))
+      throw std::runtime_error("Unknown status in the stream");
+    return load_decorator(force(name, static_cast<status>(st)), depth);
+  }
+  case node_type::reactive:
+    return load_decorator(reactive(name), depth);
+  case node_type::custom:
+    break;
+  }
+
+  throw std::runtime_error("Unsupported node type");
+}
+
+node::ptr binary_reader::load_switch(std::string_view name, size_t depth) {
+  bool const keyed = get() != 0;
+  auto stmt = keyed ? _registry.make_switch(name) : make_node<switch_>(name);
+
+  size_t const groups = get_size();
+  for (size_t n = 0; n < groups; ++n) {
+    size_t const cases = get_size();
+    if (cases == 0)
+      throw std::runtime_error("The switch group has no cases");
+
+    auto next_condition = [&] {
+      auto condition = load_node(depth + 1);
+      if (!condition)
+        throw std::runtime_error("The switch case has no condition");
+      return condition;
+    };
+
+    // The cases added through the proxy are mapped to the same handler
+    auto proxy = keyed ? stmt->case_(get_key()) : stmt->case_(next_condition());
+    for (size_t i = 1; i < cases; ++i) {
+      if (keyed)
+        std::move(proxy).case_(get_key());
+      else
+        std::move(proxy).case_(next_condition());
+    }
+
+    if (auto handler = load_node(depth + 1))
+      std::move(proxy).handler(std::move(handler));
+  }
+
+  if (auto handler = load_node(depth + 1))
+    stmt->default_(std::move(handler));
+
+  return stmt;
+}
+
+template <typename Control>
+node::ptr binary_reader::load_control(Control &&ref, size_t depth) {
+  auto ptr = make_node<std::decay_t<Control>>(std::forward<Control>(ref));
+  size_t const count = get_size();
+  for (size_t i = 0; i < count; ++i) {
+    auto child = load_node(depth + 1);
+    if (!child)
+      throw std::runtime_error("The control node has a missing child");
+    ptr->add(std::move(child));
+  }
+  return ptr;
+}
+
+template <typename Decorator>
+node::ptr binary_reader::load_decorator(Decorator &&ref, size_t depth) {
+  auto ptr = make_node<std::decay_t<Decorator>>(std::forward<Decorator>(ref));
+  if (auto child = load_node(depth + 1))
+    ptr->child(std::move(child));
+  return ptr;
+}
+
+std::uint8_t binary_reader::get() {
+  if (!_stream) {
+    if (_image.empty())
+      throw std::runtime_error("Unexpected end of the image");
+    auto const ch = _image.front();
+    _image.remove_prefix(1);
+    return static_cast<std::uint8_t>(ch);
+  }
+
+  auto const ch = _stream->sbumpc();
+  if (ch == std::streambuf::traits_type::eof())
+    throw std::runtime_error("Unexpected end of the stream");
+  return static_cast<std::uint8_t>(ch);
+}
+
+char const *binary_reader::get_chars(size_t size) {
+  if (!_stream) {
+    if (_image.size() < size)
+      throw std::runtime_error("Unexpected end of the image");
+    char const *const chars = _image.data();
+    _image.remove_prefix(size);
+    return chars;
+  }
+
+  char *const chars = _tree->allocate(size);
+  if (_stream->sgetn(chars, static_cast<std::streamsize>(size)) !=
+      static_cast<std::streamsize>(size))
+    throw std::runtime_error("Unexpected end of the stream");
+  return chars;
+}
+
+std::uint64_t binary_reader::get_varint() {
+  std::uint64_t value = {};
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    std::uint8_t const byte = get();
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+  throw std::runtime_error("Invalid integer in the stream");
+}
+
+size_t binary_reader::get_size() {
+  auto const value = get_varint();
+  if (value > std::numeric_limits<size_t>::max())
+    throw std::runtime_error("Invalid integer in the stream");
+  return static_cast<size_t>(value);
+}
+
+switch_key binary_reader::get_key() {
+  auto const bits = get_varint();
+  return static_cast<switch_key>((bits >> 1) ^ (~(bits & 1) + 1));
+}
+
+std::string_view binary_reader::get_name() {
+  size_t const idx = get_size();
+  if (idx >= _names.size())
+    throw std::runtime_error("Invalid name index in the stream");
+  return _names[idx];
+}
+
+// The single pass parser of the text format. The lines are read one by one,
+// the nodes are created as soon as their headers are parsed and the children
+// are recognized by the indentation.
+class text_reader final {
+public:
+  text_reader(std::istream &stream, registry const &reg);
+
+  node::ptr load();
+
+private:
+  // The decorators continue the line of their child, so the nesting depth is
+  // counted apart from the indentation layer
+  node::ptr load_node(size_t layer, size_t depth);
+  node::ptr load_leaf(node_type type, std::string_view name);
+  node::ptr load_switch(std::string_view name, size_t layer, size_t depth);
+  template <typename Control>
+  node::ptr load_control(Control &&ref, size_t layer, size_t depth);
+  template <typename Decorator>
+  node::ptr load_decorator(Decorator &&ref, size_t layer, size_t depth);
+
+  bool next_line();
+  bool block();
+  bool at(size_t layer, std::string_view prefix);
+  bool eol() const;
+  bool skip(std::string_view token);
+  void expect(std::string_view token);
+  void expect_eol();
+  node_type get_type();
+  std::string_view get_param(std::string_view key);
+  size_t get_size(std::string_view key);
+  std::string_view get_name();
+  switch_key get_key();
+  [[noreturn]] void error(char const *what) const;
+
+private:
+  std::istream &_stream;
+  registry const &_registry;
+  std::shared_ptr<loaded_tree> _tree;
+  std::string _line;
+  std::string_view _rest; // The unparsed part of the current line
+  size_t _layer{};        // Indentation level of the current line
+  size_t _number{};       // Number of the current line
+  bool _eof{};
+};
+
+text_reader::text_reader(std::istream &stream, registry const &reg)
+    : _stream(stream), _registry(reg) {}
+
+node::ptr text_reader::load() {
+  _tree = std::allocate_shared<loaded_tree>(allocator<loaded_tree>());
+
+  if (next_line()) {
+    if (_layer != 0)
+      error("The root node is indented");
+    _tree->root = load_node(0, 1);
+    if (!_eof)
+      error("Unexpected node");
+  }
+
+  return make_root(_tree);
+}
+
+node::ptr text_reader::load_node(size_t layer, size_t depth) {
+  if (depth > max_load_depth)
+    error("The tree is nested too deeply");
+
+  auto const type = get_type();
+
+  std::string_view param;
+  if (type == node_type::parallel)
+    param = get_param("threshold");
+  else if (type == node_type::repeat || type == node_type::retry)
+    param = get_param("n");
+  else if (type == node_type::force)
+    param = get_param("status");
+
+  auto const name = get_name();
+
+  auto to_size = [&] {
+    size_t value = {};
+    auto const res =
+        std::from_chars(param.data(), param.data() + param.size(), value);
+    if (res.ec != std::errc() || res.ptr != param.data() + param.size())
+      error("Invalid number");
+    return value;
+  };
+
+  switch (type) {
+  case node_type::action:
+  case node_type::condition:
+    return load_leaf(type, name);
+  case node_type::sequence:
+    return load_control(sequence(name), layer, depth);
+  case node_type::fallback:
+    return load_control(fallback(name), layer, depth);
+  case node_type::parallel:
+    return load_control(parallel(name, to_size()), layer, depth);
+  case node_type::if_: {
+    auto stmt = make_node<if_>(name);
+    if (!block())
+      return stmt;
+    if (at(layer + 1, lex::pred))
+      stmt->condition(load_node(layer + 1, depth + 1));
+    if (at(layer + 1, lex::then_))
+      stmt->then_(load_node(layer + 1, depth + 1));
+    if (at(layer + 1, lex::else_))
+      stmt->else_(load_node(layer + 1, depth + 1));
+    return stmt;
+  }
+  case node_type::switch_:
+    return load_switch(name, layer, depth);
+  case node_type::invert:
+    return load_decorator(invert(name), layer, depth);
+  case node_type::repeat:
+    return load_decorator(repeat(name, to_size()), layer, depth);
+  case node_type::retry:
+    return load_decorator(retry(name, to_size()), layer, depth);
+  case node_type::force:
+    for (auto st : {status::success, status::failure, status::running}) {
+      if (param == to_string(st))
+        return load_decorator(force(name, st), layer, depth);
+    }
+    error("Unknown status");
+  case node_type::reactive:
+    return load_decorator(reactive(name), layer, depth);
+  case node_type::custom:
+    break;
+  }
+
+  error("Unsupported node type");
+}
+
+node::ptr text_reader::load_leaf(node_type type, std::string_view name) {
+  expect_eol();
+  next_line();
+  return type == node_type::action ? _registry.make_action(name)
+                                   : _registry.make_condition(name);
+}
+
+node::ptr text_reader::load_switch(std::string_view name, size_t layer,
+                                   size_t depth) {
+  // The key extractor is registered for the keyed switches
+  bool const keyed = _registry.has_key(name);
+  auto stmt = keyed ? _registry.make_switch(name) : make_node<switch_>(name);
+
+  if (!block())
+    return stmt;
+
+  // The cases are mapped to the handler following them
+  std::optional<case_proxy> proxy;
+
+  while (!_eof && _layer == layer + 1) {
+    if (at(layer + 1, lex::case_)) {
+      if (keyed) {
+        if (get_type() != node_type::condition)
+          error("The keyed switch case is not a condition");
+        auto const value = get_key();
+        expect_eol();
+        next_line();
+        if (proxy)
+          std::move(*proxy).case_(value);
+        else
+          proxy.emplace(stmt->case_(value));
+      } else {
+        auto condition = load_node(layer + 1, depth + 1);
+        if (proxy)
+          std::move(*proxy).case_(std::move(condition));
+        else
+          proxy.emplace(stmt->case_(std::move(condition)));
+      }
+
+      if (at(layer + 2, lex::body)) {
+        std::move(*proxy).handler(load_node(layer + 2, depth + 1));
+        proxy.reset();
+      }
+    } else if (at(layer + 1, lex::default_)) {
+      stmt->default_(load_node(layer + 1, depth + 1));
+    } else {
+      error("Unexpected switch item");
+    }
+  }
+
+  return stmt;
+}
+
+template <typename Control>
+node::ptr text_reader::load_control(Control &&ref, size_t layer,
+                                    size_t depth) {
+  auto ptr = make_node<std::decay_t<Control>>(std::forward<Control>(ref));
+
+  if (!block())
+    return ptr;
+
+  while (at(layer + 1, lex::item))
+    ptr->add(load_node(layer + 1, depth + 1));
+
+  return ptr;
+}
+
+template <typename Decorator>
+node::ptr text_reader::load_decorator(Decorator &&ref, size_t layer,
+                                      size_t depth) {
+  auto ptr = make_node<std::decay_t<Decorator>>(std::forward<Decorator>(ref));
+
+  expect(": ");
+  if (_rest == lex::none) {
+    _rest = {};
+    next_line();
   } else {
-    _stream << lex::none << std::endl;
+    // The child continues the line
+    ptr->child(load_node(layer, depth + 1));
   }
+
+  return ptr;
+}
+
+bool text_reader::next_line() {
+  while (std::getline(_stream, _line)) {
+    ++_number;
+
+    std::string_view line = _line;
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+
+    size_t const spaces = line.find_first_not_of(' ');
+    if (spaces == std::string_view::npos)
+      continue;
+    if (spaces % 2 != 0)
+      error("Invalid indentation");
+
+    _layer = spaces / 2;
+    _rest = line.substr(spaces);
+    return true;
+  }
+
+  if (_stream.bad())
+    throw std::runtime_error("Unable to read the stream");
+
+  _eof = true;
+  _rest = {};
+  return false;
+}
+
+// Parse the end of the control node header. The children follow on the next
+// lines unless the node is empty.
+bool text_reader::block() {
+  expect(":");
+  bool const empty = skip(" ") && skip(lex::none);
+  expect_eol();
+  next_line();
+  return !empty;
+}
+
+// Skip the prefix if the current line is a child item at the given layer
+bool text_reader::at(size_t layer, std::string_view prefix) {
+  return !_eof && _layer == layer && skip(prefix);
+}
+
+bool text_reader::eol() const { return _rest.empty(); }
+
+bool text_reader::skip(std::string_view token) {
+  if (_rest.substr(0, token.size()) != token)
+    return false;
+  _rest.remove_prefix(token.size());
+  return true;
+}
+
+void text_reader::expect(std::string_view token) {
+  if (!skip(token))
+    error("Unexpected token");
+}
+
+void text_reader::expect_eol() {
+  if (!eol())
+    error("Unexpected token at the end of the line");
+}
+
+node_type text_reader::get_type() {
+  size_t const size = _rest.find(' ');
+  auto const word = _rest.substr(0, size);
+
+  for (size_t i = 0; i < static_cast<size_t>(node_type::custom); ++i) {
+    auto const type = static_cast<node_type>(i);
+    if (word == to_string(type)) {
+      _rest.remove_prefix(word.size());
+      expect(" ");
+      return type;
+    }
+  }
+
+  error("Unknown node type");
+}
+
+std::string_view text_reader::get_param(std::string_view key) {
+  expect(key);
+  expect("=");
+  size_t const size = _rest.find(' ');
+  auto const value = _rest.substr(0, size);
+  _rest.remove_prefix(value.size());
+  expect(" ");
+  return value;
+}
+
+std::string_view text_reader::get_name() {
+  expect("\"");
+
+  // The quotes inside the names are escaped
+  size_t size = {}, end = {};
+  for (; end < _rest.size() && _rest[end] != '"'; ++end, ++size) {
+    if (_rest[end] == '\\' && end + 1 < _rest.size() && _rest[end + 1] == '"')
+      ++end;
+  }
+  if (end == _rest.size())
+    error("Unterminated name");
+
+  char *const name = _tree->allocate(size);
+  for (size_t i = 0, j = 0; i < end; ++i, ++j) {
+    if (_rest[i] == '\\' && i + 1 < end && _rest[i + 1] == '"')
+      ++i;
+    name[j] = _rest[i];
+  }
+
+  _rest.remove_prefix(end + 1);
+  return std::string_view(name, size);
+}
+
+switch_key text_reader::get_key() {
+  auto const name = get_name();
+  switch_key value = {};
+  auto const res =
+      std::from_chars(name.data(), name.data() + name.size(), value);
+  if (res.ec != std::errc() || res.ptr != name.data() + name.size())
+    error("Invalid switch key");
+  return value;
+}
+
+void text_reader::error(char const *what) const {
+  throw std::runtime_error(std::string(what) + " at line " +
+                           std::to_string(_number));
 }
 
 } // namespace
 
+node::ptr registry::make_action(std::string_view name) const {
+  auto it = _actions.find(name);
+  if (it == _actions.end())
+    throw std::runtime_error("The action '" + std::string(name) +
+                             "' is not registered");
+
+  auto const *entry = &it->second;
+  if (!entry->halt)
+    return make_node<bhv::action>(name, [entry] { return entry->fn(); });
+  return make_node<bhv::action>(
+      name, [entry] { return entry->fn(); }, [entry] { entry->halt(); });
+}
+
+node::ptr registry::make_condition(std::string_view name) const {
+  auto it = _conditions.find(name);
+  if (it == _conditions.end())
+    throw std::runtime_error("The condition '" + std::string(name) +
+                             "' is not registered");
+
+  auto const *entry = &it->second;
+  return make_node<bhv::condition>(
+      name,
+      [](void *ctx) { return static_cast<condition_entry *>(ctx)->fn(); },
+      const_cast<condition_entry *>(entry), entry->inputs);
+}
+
+bool registry::has_key(std::string_view name) const {
+  return _keys.find(name) != _keys.end();
+}
+
+std::shared_ptr<switch_> registry::make_switch(std::string_view name) const {
+  auto it = _keys.find(name);
+  if (it == _keys.end())
+    throw std::runtime_error("The key of the switch '" + std::string(name) +
+                             "' is not registered");
+
+  auto const *extractor = &it->second;
+  return make_node<switch_>(name, [extractor] { return (*extractor)(); });
+}
+
+void save(std::ostream &stream, node const &ref, format fmt) {
+  std::string buffer;
+
+  switch (fmt) {
+  case format::text:
+    serializer(buffer, &stream) << ref;
+    return;
+  case format::binary:
+    binary_writer(buffer, &stream) << ref;
+    return;
+  }
+  throw std::runtime_error("Unsupported format");
+}
+
+void save(std::string &buffer, node const &ref, format fmt) {
+  switch (fmt) {
+  case format::text:
+    serializer(buffer) << ref;
+    return;
+  case format::binary:
+    binary_writer(buffer) << ref;
+    return;
+  }
+  throw std::runtime_error("Unsupported format");
+}
+
+node::ptr load(std::istream &stream, registry const &reg, format fmt) {
+  switch (fmt) {
+  case format::text:
+    return text_reader(stream, reg).load();
+  case format::binary:
+    return binary_reader(stream, reg).load();
+  }
+  throw std::runtime_error("Unsupported format");
+}
+
+node::ptr load(std::string_view image, registry const &reg,
+               std::shared_ptr<void const> owner) {
+  return binary_reader(image, reg, std::move(owner)).load();
+}
+
 std::ostream &operator<<(std::ostream &stream, node const &ref) {
-  serializer ss(stream);
-  ss << ref;
+  save(stream, ref, format::text);
   return stream;
 }
 
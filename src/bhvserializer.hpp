@@ -22,19 +22,183 @@
 
 #pragma once
 #include "bhvtree.hpp"
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace cppttl {
 namespace bhv {
 
+/**
+ * @brief Serialization formats
+ */
+enum class format {
+  text,  // Human readable text, the same as operator<<
+  binary // Compact binary format
+};
+
+/**
+ * @brief The named leaf handlers used to bind the leaves of the loaded trees.
+ * The actions and the conditions are bound by the leaf names and the key
+ * extractors by the names of the keyed switch nodes.
+ *
+ * The loaded leaves call the registered handlers, so the registry must outlive
+ * the loaded trees.
+ */
+class registry {
+public:
+  registry() = default;
+  registry(registry &&) = default;
+  registry &operator=(registry &&) = default;
+
+  template <typename Fn, typename R = return_t<Fn, status>>
+  registry &action(std::string_view name, Fn &&fn);
+  template <typename Fn, typename Halt,
+            typename = std::enable_if_t<std::is_invocable_v<Halt &>>,
+            typename R = return_t<Fn, status>>
+  registry &action(std::string_view name, Fn &&fn, Halt &&halt);
+
+  template <typename Fn, typename... Inputs,
+            typename = std::enable_if_t<(std::is_base_of_v<input, Inputs> &&
+                                         ...)>,
+            typename R = return_t<Fn, bool>>
+  registry &condition(std::string_view name, Fn &&fn,
+                      Inputs const &...inputs);
+
+  template <typename Fn, typename K = std::invoke_result_t<Fn &>,
+            typename = std::enable_if_t<is_switch_key_v<K>>>
+  registry &key(std::string_view name, Fn &&fn);
+
+  /**
+   * @brief Create the leaf bound to the registered handler
+   * @throw std::runtime_error if the handler isn't registered
+   */
+  node::ptr make_action(std::string_view name) const;
+  node::ptr make_condition(std::string_view name) const;
+
+  /**
+   * @brief Create the keyed switch bound to the registered key extractor
+   * @throw std::runtime_error if the key extractor isn't registered
+   */
+  std::shared_ptr<switch_> make_switch(std::string_view name) const;
+  bool has_key(std::string_view name) const;
+
+private:
+  struct action_entry {
+    bhv::action::handler fn;
+    bhv::action::halt_handler halt;
+  };
+
+  struct condition_entry {
+    bhv::condition::predicate fn;
+    bhv::condition::inputs_list inputs;
+  };
+
+  template <typename T> using table = std::map<std::string, T, std::less<>>;
+
+  table<action_entry> _actions;
+  table<condition_entry> _conditions;
+  table<switch_::key_extractor> _keys;
+};
+
+template <typename Fn, typename R>
+registry &registry::action(std::string_view name, Fn &&fn) {
+  _actions[std::string(name)] = {std::forward<Fn>(fn), nullptr};
+  return *this;
+}
+
+template <typename Fn, typename Halt, typename, typename R>
+registry &registry::action(std::string_view name, Fn &&fn, Halt &&halt) {
+  _actions[std::string(name)] = {std::forward<Fn>(fn),
+                                 std::forward<Halt>(halt)};
+  return *this;
+}
+
+template <typename Fn, typename... Inputs, typename, typename R>
+registry &registry::condition(std::string_view name, Fn &&fn,
+                              Inputs const &...inputs) {
+  auto &entry = _conditions[std::string(name)];
+  entry.fn = std::forward<Fn>(fn);
+  entry.inputs.clear();
+  if constexpr (sizeof...(Inputs) != 0)
+    entry.inputs = {static_cast<input const *>(&inputs)...};
+  return *this;
+}
+
+template <typename Fn, typename K, typename>
+registry &registry::key(std::string_view name, Fn &&fn) {
+  _keys[std::string(name)] = [fn = std::forward<Fn>(fn)]() mutable {
+    return to_switch_key(fn());
+  };
+  return *this;
+}
+
+/**
+ * @brief Function for serializing the behavior tree to a stream
+ *
+ * The binary format keeps the node types, the parameters, the names and the
+ * grouping of the switch cases. The leaves are stored by names only. Custom
+ * nodes are not supported.
+ *
+ * @param [in] stream   Reference to any output stream
+ * @param [in] ref      Reference to a behavior tree
+ * @param [in] fmt      Serialization format
+ */
+void save(std::ostream &stream, node const &ref, format fmt);
+
+/**
+ * @brief Function for serializing the behavior tree into the character buffer
+ *
+ * The tree is appended to the buffer. The buffer can be reused, so the text
+ * serialization doesn't allocate once the buffer capacity is sufficient.
+ *
+ * @param [out] buffer  The character buffer
+ * @param [in]  ref     Reference to a behavior tree
+ * @param [in]  fmt     Serialization format
+ */
+void save(std::string &buffer, node const &ref, format fmt);
+
+/**
+ * @brief Maximum nesting depth of the loaded trees, the root is at depth 1.
+ * The loaders reject deeper trees with std::runtime_error, so malformed input
+ * can't overflow the stack.
+ */
+constexpr size_t max_load_depth = 256;
+
 /**
  * @brief Function for deserializing the behavior tree from a stream
  *
+ * The leaves are bound to the handlers of the registry. The node names are
+ * owned by the returned root node. The parallel nodes are loaded without
+ * executors. The trees nested deeper than max_load_depth are rejected.
+ *
  * @param [in]  stream  Reference to any input stream
+ * @param [in]  reg     Registry of the leaf handlers
+ * @param [in]  fmt     Serialization format
+ * @return node::ptr    Pointer to a deserialized behavior tree
+ */
+node::ptr load(std::istream &stream, registry const &reg, format fmt);
+
+/**
+ * @brief Function for loading the behavior tree from the binary image in
+ * memory without copying
+ *
+ * The node names refer to the image in place, so the image must outlive the
+ * loaded tree. Otherwise the owner of the image can be passed, it's kept by the
+ * returned root node. The trees nested deeper than max_load_depth are
+ * rejected.
+ *
+ * @param [in]  image   The binary image
+ * @param [in]  reg     Registry of the leaf handlers
+ * @param [in]  owner   Optional owner of the image memory
  * @return node::ptr    Pointer to a deserialized behavior tree
  */
-// node::ptr load(std::istream &stream);
+node::ptr load(std::string_view image, registry const &reg,
+               std::shared_ptr<void const> owner = {});
 
 /**
  * @brief Function for serializing the behavior tree to a stream
@@ -0,0 +1,331 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#include "bhvtrace.hpp"
+#include "bhvprofiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+namespace cppttl {
+namespace bhv {
+namespace trace {
+
+namespace {
+
+constexpr char magic[] = {'B', 'H', 'V', 'E'};
+constexpr std::uint8_t version = 1;
+
+enum tag : std::uint8_t { node_tag = 1, event_tag, dropped_tag };
+
+struct slot {
+  std::uint64_t time;
+  node const *source;
+  kind what;
+  status result;
+};
+
+/**
+ * @brief Single producer single consumer ring buffer.
+ * The producer is the owning thread, the consumer is the drain holding the
+ * buffers lock.
+ */
+class ring {
+public:
+  ring(size_t capacity, std::uint32_t thread)
+      : _slots(new slot[capacity]), _mask(capacity - 1), _thread(thread) {}
+
+  void push(slot const &item) {
+    size_t const head = _head.load(std::memory_order_relaxed);
+    if (head - _tail_cache > _mask) {
+      _tail_cache = _tail.load(std::memory_order_acquire);
+      if (head - _tail_cache > _mask) {
+        _dropped.store(_dropped.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return;
+      }
+    }
+    _slots[head & _mask] = item;
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  size_t pop(std::vector<event> &dst) {
+    size_t const tail = _tail.load(std::memory_order_relaxed);
+    size_t const head = _head.load(std::memory_order_acquire);
+    for (size_t i = tail; i != head; ++i) {
+      auto const &item = _slots[i & _mask];
+      dst.push_back({item.time, reinterpret_cast<std::uintptr_t>(item.source),
+                     _thread, item.what, item.result});
+    }
+    _tail.store(head, std::memory_order_release);
+    return head - tail;
+  }
+
+  std::uint64_t dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::unique_ptr<slot[]> _slots;
+  size_t const _mask;
+  std::uint32_t const _thread;
+  alignas(64) std::atomic<size_t> _head{0};
+  size_t _tail_cache = 0;
+  std::atomic<std::uint64_t> _dropped{0};
+  alignas(64) std::atomic<size_t> _tail{0};
+};
+
+struct buffers {
+  std::atomic<bool> active{false};
+  std::atomic<size_t> capacity{default_capacity};
+
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ring>> rings;
+  std::uint32_t threads = 0;
+  std::uint64_t dropped = 0; // Dropped by the finished threads
+
+  static buffers &get() {
+    static buffers instance;
+    return instance;
+  }
+};
+
+thread_local std::shared_ptr<ring> local_ring;
+
+ring &attach(buffers &all) {
+  std::lock_guard<std::mutex> lock(all.mutex);
+  local_ring = std::make_shared<ring>(
+      all.capacity.load(std::memory_order_relaxed), all.threads++);
+  all.rings.push_back(local_ring);
+  return *local_ring;
+}
+
+template <typename T> void put(std::string &buf, T value) {
+  for (size_t i = 0; i < sizeof(T); ++i)
+    buf.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+}
+
+template <typename T> T get(std::istream &in) {
+  unsigned char bytes[sizeof(T)];
+  if (!in.read(reinterpret_cast<char *>(bytes), sizeof bytes))
+    throw std::runtime_error("Unexpected end of the trace file");
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i)
+    value |= static_cast<T>(bytes[i]) << (i * 8);
+  return value;
+}
+
+void describe(std::string &buf, std::unordered_set<node const *> &described,
+              node const &ref) {
+  if (!described.insert(&ref).second)
+    return;
+
+  put<std::uint8_t>(buf, node_tag);
+  put<std::uint64_t>(buf, reinterpret_cast<std::uintptr_t>(&ref));
+  put<std::uint8_t>(buf, static_cast<std::uint8_t>(ref.type()));
+  put<std::uint32_t>(buf, static_cast<std::uint32_t>(ref.name().size()));
+  buf.append(ref.name());
+
+  switch (ref.type()) {
+  case node_type::action:
+  case node_type::condition:
+  case node_type::custom:
+    break;
+  case node_type::switch_: {
+    auto const &stmt = static_cast<switch_ const &>(ref);
+    for (auto &&case_ : stmt) {
+      if (case_.condition())
+        describe(buf, described, *case_.condition());
+      if (case_.handler())
+        describe(buf, described, *case_.handler());
+    }
+    if (stmt.default_handler())
+      describe(buf, described, *stmt.default_handler());
+    break;
+  }
+  default:
+    for (auto const &child : static_cast<basic_control const &>(ref).childs()) {
+      if (child)
+        describe(buf, described, *child);
+    }
+    break;
+  }
+}
+
+} // namespace
+
+void start() {
+  buffers::get().active.store(true, std::memory_order_relaxed);
+}
+
+void stop() {
+  buffers::get().active.store(false, std::memory_order_relaxed);
+}
+
+bool active() {
+  return buffers::get().active.load(std::memory_order_relaxed);
+}
+
+void set_capacity(size_t events) {
+  size_t capacity = 1;
+  while (capacity < events)
+    capacity <<= 1;
+  buffers::get().capacity.store(capacity, std::memory_order_relaxed);
+}
+
+size_t drain(std::vector<event> &events) {
+  auto &all = buffers::get();
+  std::lock_guard<std::mutex> lock(all.mutex);
+
+  size_t count = 0;
+  for (auto it = all.rings.begin(); it != all.rings.end();) {
+    count += (*it)->pop(events);
+    // The buffer of the finished thread is released once drained
+    if (it->use_count() == 1) {
+      all.dropped += (*it)->dropped();
+      it = all.rings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+std::uint64_t dropped() {
+  auto &all = buffers::get();
+  std::lock_guard<std::mutex> lock(all.mutex);
+
+  std::uint64_t count = all.dropped;
+  for (auto const &buffer : all.rings)
+    count += buffer->dropped();
+  return count;
+}
+
+void record(node const &ref, kind what, status result) {
+  auto &all = buffers::get();
+  if (!all.active.load(std::memory_order_relaxed))
+    return;
+
+  ring *buffer = local_ring.get();
+  if (!buffer)
+    buffer = &attach(all);
+  buffer->push({profiler::now(), &ref, what, result});
+}
+
+// writer
+writer::writer(std::ostream &out) : _out(out), _dropped(trace::dropped()) {
+  _out.write(magic, sizeof magic);
+  _out.put(static_cast<char>(version));
+}
+
+void writer::describe(node const &root) {
+  std::string buf;
+  std::unordered_set<node const *> described;
+  trace::describe(buf, described, root);
+  _out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+}
+
+size_t writer::drain() {
+  _events.clear();
+  size_t const count = trace::drain(_events);
+
+  std::string buf;
+  buf.reserve(count * 23 + 9);
+  for (auto const &item : _events) {
+    put<std::uint8_t>(buf, event_tag);
+    put<std::uint64_t>(buf, item.time);
+    put<std::uint64_t>(buf, item.node);
+    put<std::uint32_t>(buf, item.thread);
+    put<std::uint8_t>(buf, static_cast<std::uint8_t>(item.what));
+    // The invalid statuses returned by the nodes are kept, saturated to a byte
+    auto const st = static_cast<unsigned>(item.result);
+    put<std::uint8_t>(buf, static_cast<std::uint8_t>(std::min(st, 0xffu)));
+  }
+
+  auto const total = trace::dropped();
+  if (total > _dropped) {
+    put<std::uint8_t>(buf, dropped_tag);
+    put<std::uint64_t>(buf, total - _dropped);
+    _dropped = total;
+  }
+
+  _out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+  return count;
+}
+
+file read(std::istream &in) {
+  char header[sizeof magic + 1];
+  if (!in.read(header, sizeof header) ||
+      !std::equal(magic, magic + sizeof magic, header) ||
+      static_cast<std::uint8_t>(header[sizeof magic]) != version)
+    throw std::runtime_error("Invalid trace file");
+
+  file result;
+  for (int t = in.get(); t != std::istream::traits_type::eof(); t = in.get()) {
+    switch (t) {
+    case node_tag: {
+      node_info info;
+      info.node = get<std::uint64_t>(in);
+      auto const type = get<std::uint8_t>(in);
+      if (type > static_cast<std::uint8_t>(node_type::custom))
+        throw std::runtime_error("Invalid node type in the trace file");
+      info.type = static_cast<node_type>(type);
+      info.name.resize(get<std::uint32_t>(in));
+      if (!in.read(info.name.data(),
+                   static_cast<std::streamsize>(info.name.size())))
+        throw std::runtime_error("Unexpected end of the trace file");
+      result.nodes.push_back(std::move(info));
+      break;
+    }
+    case event_tag: {
+      event item;
+      item.time = get<std::uint64_t>(in);
+      item.node = get<std::uint64_t>(in);
+      item.thread = get<std::uint32_t>(in);
+      auto const what = get<std::uint8_t>(in);
+      auto const st = get<std::uint8_t>(in);
+      if (what > static_cast<std::uint8_t>(kind::exception))
+        throw std::runtime_error("Invalid event in the trace file");
+      item.what = static_cast<kind>(what);
+      item.result = static_cast<status>(st);
+      result.events.push_back(item);
+      break;
+    }
+    case dropped_tag:
+      result.dropped += get<std::uint64_t>(in);
+      break;
+    default:
+      throw std::runtime_error("Invalid record in the trace file");
+    }
+  }
+  return result;
+}
+
+} // namespace trace
+} // namespace bhv
+} // namespace cppttl
@@ -0,0 +1,154 @@
+/*
+ Copyright (c) 2024 Vladislav Volkov <wwwvladislav@gmail.com>
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+#pragma once
+#include "bhvtree.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace cppttl {
+namespace bhv {
+
+/**
+ * @brief Execution trace of the node ticks.
+ * The events are recorded only if the library is built with the BHVT_TRACING
+ * option and the tracing is started. Every thread records the events into its
+ * own fixed-size lock-free ring buffer, so the recording never blocks the
+ * ticking thread; the events which don't fit into the full buffer are dropped
+ * and counted. A consumer drains the buffers, e.g. into a trace file.
+ */
+namespace trace {
+
+#ifdef BHVT_TRACING
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+/**
+ * @brief Default capacity of the thread buffers in events
+ */
+constexpr size_t default_capacity = 16384;
+
+enum class kind : std::uint8_t { enter, exit, exception };
+
+/**
+ * @brief Trace event. The node is identified by its address, the time is
+ * measured by the profiler clock (profiler::now()). The result is valid for the
+ * exit events only, the invalid statuses returned by the nodes are kept as is
+ * (saturated to 255).
+ */
+struct event {
+  std::uint64_t time;
+  std::uint64_t node;
+  std::uint32_t thread;
+  kind what;
+  status result;
+};
+
+/**
+ * @brief Description of the traced node
+ */
+struct node_info {
+  std::uint64_t node;
+  node_type type;
+  std::string name;
+};
+
+/**
+ * @brief The content of the trace file
+ */
+struct file {
+  std::vector<node_info> nodes;
+  std::vector<event> events;
+  std::uint64_t dropped = 0;
+};
+
+/**
+ * @brief Start or stop recording the events on all threads
+ */
+void start();
+void stop();
+bool active();
+
+/**
+ * @brief Set the capacity of the buffers created after the call.
+ * The capacity is rounded up to the power of two.
+ */
+void set_capacity(size_t events);
+
+/**
+ * @brief Move the recorded events of all threads to the list
+ * @return size_t   Number of the drained events
+ */
+size_t drain(std::vector<event> &events);
+
+/**
+ * @brief Total number of the events dropped because of the full buffers
+ */
+std::uint64_t dropped();
+
+/**
+ * @brief Record the event of the node. Called by node::operator().
+ */
+void record(node const &ref, kind what, status result = status::running);
+
+/**
+ * @brief Writer of the binary trace file.
+ * The file contains the descriptions of the nodes, the events and the numbers
+ * of the dropped events in the order of the writing.
+ */
+class writer {
+public:
+  explicit writer(std::ostream &out);
+
+  /**
+   * @brief Write the descriptions of the tree nodes, so the events can be
+   * matched with the node names offline
+   */
+  void describe(node const &root);
+
+  /**
+   * @brief Drain the thread buffers into the file
+   * @return size_t   Number of the written events
+   */
+  size_t drain();
+
+private:
+  std::ostream &_out;
+  std::vector<event> _events;
+  std::uint64_t _dropped = 0;
+};
+
+/**
+ * @brief Read the trace file
+ * @throw std::runtime_error if the file is invalid
+ */
+file read(std::istream &in);
+
+} // namespace trace
+
+} // namespace bhv
+} // namespace cppttl
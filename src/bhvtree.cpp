@@ -21,7 +21,22 @@
  */
 
 #include "bhvtree.hpp"
+#include "bhvexecutor.hpp"
+#ifdef BHVT_PROFILING
+#include "bhvprofiler.hpp"
+#endif
+#ifdef BHVT_TRACING
+#include "bhvtrace.hpp"
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <deque>
+#include <exception>
+#include <numeric>
 #include <stdexcept>
+#include <thread>
 
 namespace cppttl {
 namespace bhv {
@@ -41,25 +56,146 @@ char const *to_string(status st) {
 char const *to_string(node_type type) {
   static const char *names[] = {
       "action", "condition", "sequence", "fallback", "parallel", "if",
-      "switch", "invert",    "repeat",   "retry",    "force",    "custom",
+      "switch", "invert",    "repeat",   "retry",    "force",    "reactive",
+      "custom",
   };
   static_assert(static_cast<size_t>(node_type::custom) + 1 ==
                 sizeof(names) / sizeof *names);
   return names[static_cast<size_t>(type)];
 }
 
+// memory resource
+namespace {
+thread_local std::pmr::memory_resource *memory_resource = nullptr;
+}
+
+std::pmr::memory_resource *get_memory_resource() {
+  return memory_resource ? memory_resource : std::pmr::get_default_resource();
+}
+
+std::pmr::memory_resource *
+set_memory_resource(std::pmr::memory_resource *resource) {
+  std::swap(memory_resource, resource);
+  return resource;
+}
+
+// tick_budget
+namespace {
+
+thread_local tick_budget *current_budget = nullptr;
+
+/**
+ * @brief Spend a step of the current tick budget before proceeding to the next
+ * child or iteration. The first child of the tick is always ticked.
+ */
+bool proceed(size_t ticked) {
+  return !ticked || !current_budget || current_budget->spend();
+}
+
+} // namespace
+
+tick_budget::tick_budget(size_t quota)
+    : _deadline(clock::time_point::max()), _quota(quota), _timed(false) {}
+
+tick_budget::tick_budget(clock::duration timeout, size_t quota)
+    : tick_budget(clock::now() + timeout, quota) {}
+
+tick_budget::tick_budget(clock::time_point deadline, size_t quota)
+    : _deadline(deadline), _quota(quota), _timed(true) {}
+
+bool tick_budget::spend() {
+  if (_exhausted)
+    return false;
+
+  if (_quota == 0 || (_timed && clock::now() >= _deadline)) {
+    _exhausted = true;
+    return false;
+  }
+
+  if (_quota != unlimited)
+    --_quota;
+  return true;
+}
+
+bool tick_budget::exhausted() const { return _exhausted; }
+
 // node
 node::node(node_type type, std::string_view name) : _type(type), _name(name) {}
 
 node::~node() {}
 
+#if defined(BHVT_PROFILING) || defined(BHVT_TRACING)
+status node::operator()() {
+#ifdef BHVT_TRACING
+  trace::record(*this, trace::kind::enter);
+#endif
+#ifdef BHVT_PROFILING
+  auto const start = profiler::now();
+#endif
+  status st;
+  try {
+    st = tick();
+  } catch (...) {
+#ifdef BHVT_PROFILING
+    profiler::record(*this, profiler::now() - start, nullptr);
+#endif
+#ifdef BHVT_TRACING
+    trace::record(*this, trace::kind::exception);
+#endif
+    throw;
+  }
+#ifdef BHVT_PROFILING
+  profiler::record(*this, profiler::now() - start, &st);
+#endif
+#ifdef BHVT_TRACING
+  trace::record(*this, trace::kind::exit, st);
+#endif
+  return st;
+}
+#else
 status node::operator()() { return tick(); }
+#endif
+
+status node::operator()(tick_budget &budget) {
+  auto *const prev = std::exchange(current_budget, &budget);
+  status st;
+  try {
+    st = (*this)();
+  } catch (...) {
+    current_budget = prev;
+    throw;
+  }
+  current_budget = prev;
+  return st;
+}
+
+void node::halt() { stop(); }
+
+void node::prepare() { reserve(); }
+
+void node::stop() {}
+
+void node::reserve() {}
 
 node_type node::type() const { return _type; }
 
 std::string_view node::name() const { return _name; }
 
+// input
+void input::notify() { _version.fetch_add(1, std::memory_order_release); }
+
+std::uint64_t input::version() const {
+  return _version.load(std::memory_order_acquire);
+}
+
 // basic_control
+void basic_control::reserve() {
+  for (auto const &child : _childs) {
+    if (child)
+      child->prepare();
+  }
+}
+
 basic_control::childs_list const &basic_control::childs() const {
   return _childs;
 }
@@ -71,7 +207,11 @@ status sequence::tick() {
   status st = status::success;
 
   try {
-    for (; _running < _childs.size(); ++_running) {
+    for (size_t ticked = 0; _running < _childs.size(); ++_running, ++ticked) {
+      if (!proceed(ticked)) {
+        st = status::running;
+        break;
+      }
       auto &child = _childs[_running];
       st = (*child)();
       if (st != status::success)
@@ -88,6 +228,12 @@ status sequence::tick() {
   return st;
 }
 
+void sequence::stop() {
+  if (_running < _childs.size())
+    _childs[_running]->halt();
+  reset();
+}
+
 void sequence::reset() { _running = 0; }
 
 // fallback
@@ -97,7 +243,11 @@ status fallback::tick() {
   status st = status::failure;
 
   try {
-    for (; _running < _childs.size(); ++_running) {
+    for (size_t ticked = 0; _running < _childs.size(); ++_running, ++ticked) {
+      if (!proceed(ticked)) {
+        st = status::running;
+        break;
+      }
       auto &child = _childs[_running];
       st = (*child)();
       if (st != status::failure)
@@ -114,15 +264,27 @@ status fallback::tick() {
   return st;
 }
 
+void fallback::stop() {
+  if (_running < _childs.size())
+    _childs[_running]->halt();
+  reset();
+}
+
 void fallback::reset() { _running = 0; }
 
 // parallel
 parallel::parallel(std::string_view name, size_t threshold)
     : base(node_type::parallel, name), _threshold(threshold) {}
 
+parallel::parallel(std::string_view name, size_t threshold, executor &ex)
+    : base(node_type::parallel, name), _threshold(threshold), _executor(&ex) {}
+
 size_t parallel::threshold() const { return _threshold; }
 
 status parallel::tick() {
+  if (_executor && _childs.size() > 1)
+    return tick_concurrently();
+
   status st = status::success;
 
   try {
@@ -131,33 +293,177 @@ status parallel::tick() {
     size_t success = {};
     size_t failed = {};
 
-    for (size_t i = 0; i < _childs.size(); ++i) {
-      auto &child = _childs[i];
+    for (auto child_st : _statuses) {
+      if (child_st == status::success)
+        ++success;
+      else if (child_st == status::failure)
+        ++failed;
+    }
+
+    // The children left after the outcome is decided aren't ticked, they are
+    // halted. The children left after the budget is exhausted remain running,
+    // the next tick starts from them.
+    size_t const count = _childs.size();
+    size_t ticked = 0;
+
+    for (size_t k = 0;
+         k < count && success < _threshold && failed <= count - _threshold;
+         ++k) {
+      size_t const i = _next + k < count ? _next + k : _next + k - count;
       auto &st = _statuses[i];
 
-      if (st == status::running)
-        st = (*child)();
+      if (st != status::running)
+        continue;
+
+      if (!proceed(ticked++)) {
+        _next = i;
+        break;
+      }
+
+      st = (*_childs[i])();
       if (st == status::success)
         ++success;
       else if (st == status::failure)
         ++failed;
     }
 
-    st = success >= _threshold                  ? status::success
-         : failed > _childs.size() - _threshold ? status::failure
-                                                : status::running;
+    st = success >= _threshold         ? status::success
+         : failed > count - _threshold ? status::failure
+                                       : status::running;
 
     if (st != status::running)
-      reset();
+      stop();
   } catch (...) {
-    reset();
+    stop();
     throw;
   }
 
   return st;
 }
 
-void parallel::reset() { _statuses.clear(); }
+status parallel::tick_concurrently() {
+  // The state shared by the child ticks. Every child tick writes only its own
+  // status, the counters decide the outcome without locks.
+  struct context {
+    parallel &self;
+    std::atomic<size_t> success{};
+    std::atomic<size_t> failed{};
+    std::atomic<size_t> pending{};
+    std::atomic<bool> decided{};
+    std::atomic<bool> error{};
+    std::exception_ptr exception;
+
+    context(parallel &ref) : self(ref) {}
+
+    void decide() {
+      size_t const total = self._childs.size();
+      if (success.load(std::memory_order_relaxed) >= self._threshold ||
+          failed.load(std::memory_order_relaxed) > total - self._threshold)
+        decided.store(true, std::memory_order_relaxed);
+    }
+
+    void run(size_t i) {
+      if (!decided.load(std::memory_order_relaxed)) {
+        try {
+          status const st = (*self._childs[i])();
+          self._statuses[i] = st;
+          if (st == status::success)
+            success.fetch_add(1, std::memory_order_relaxed);
+          else if (st == status::failure)
+            failed.fetch_add(1, std::memory_order_relaxed);
+          decide();
+        } catch (...) {
+          if (!error.exchange(true))
+            exception = std::current_exception();
+          decided.store(true, std::memory_order_relaxed);
+        }
+      }
+      pending.fetch_sub(1, std::memory_order_release);
+    }
+  };
+
+  _statuses.resize(_childs.size(), status::running);
+
+  context ctx(*this);
+  size_t last = _childs.size();
+
+  for (size_t i = 0; i < _childs.size(); ++i) {
+    if (_statuses[i] == status::success)
+      ++ctx.success;
+    else if (_statuses[i] == status::failure)
+      ++ctx.failed;
+    else
+      last = i;
+  }
+
+  ctx.decide();
+
+  if (last != _childs.size()) {
+    // The last running child is ticked on the calling thread
+    for (size_t i = 0; i < last; ++i) {
+      if (_statuses[i] != status::running)
+        continue;
+      ctx.pending.fetch_add(1, std::memory_order_relaxed);
+      try {
+        _executor->submit([&ctx, i] { ctx.run(i); });
+      } catch (...) {
+        ctx.pending.fetch_sub(1, std::memory_order_relaxed);
+        ctx.decided = true;
+        while (ctx.pending.load(std::memory_order_acquire) != 0)
+          std::this_thread::yield();
+        stop();
+        throw;
+      }
+    }
+
+    ctx.pending.fetch_add(1, std::memory_order_relaxed);
+    ctx.run(last);
+
+    while (ctx.pending.load(std::memory_order_acquire) != 0) {
+      if (!_executor->run_one())
+        std::this_thread::yield();
+    }
+  }
+
+  if (ctx.error) {
+    stop();
+    std::rethrow_exception(ctx.exception);
+  }
+
+  size_t const success = ctx.success;
+  size_t const failed = ctx.failed;
+
+  status const st = success >= _threshold                  ? status::success
+                    : failed > _childs.size() - _threshold ? status::failure
+                                                           : status::running;
+
+  if (st != status::running)
+    stop();
+
+  return st;
+}
+
+void parallel::stop() {
+  halt_running();
+  reset();
+}
+
+void parallel::reserve() {
+  base::reserve();
+  _statuses.reserve(_childs.size());
+}
+
+void parallel::halt_running() {
+  for (size_t i = 0; i < _statuses.size(); ++i) {
+    if (_statuses[i] == status::running)
+      _childs[i]->halt();
+  }
+}
+
+void parallel::reset() {
+  _statuses.clear();
+  _next = 0;
+}
 
 // invert
 invert::invert(std::string_view name) : base(node_type::invert, name) {}
@@ -183,6 +489,11 @@ status invert::tick() {
   return status::failure;
 }
 
+void invert::stop() {
+  if (!_childs.empty() && _childs.front())
+    _childs.front()->halt();
+}
+
 // repeat
 repeat::repeat(std::string_view name, size_t repeat_n)
     : base(node_type::repeat, name), _n(repeat_n) {}
@@ -197,7 +508,10 @@ status repeat::tick() {
   const auto step = _n == infinitely ? 0ull : 1ull;
 
   try {
-    for (; _i < _n; _i += step) {
+    for (size_t ticked = 0; _i < _n; _i += step, ++ticked) {
+      if (!proceed(ticked))
+        return status::running;
+
       auto status = (*_childs.front())();
 
       switch (status) {
@@ -220,6 +534,12 @@ status repeat::tick() {
   return status::success;
 }
 
+void repeat::stop() {
+  if (!_childs.empty() && _childs.front())
+    _childs.front()->halt();
+  reset();
+}
+
 void repeat::reset() { _i = 0; }
 
 // retry
@@ -236,7 +556,10 @@ status retry::tick() {
   const auto step = _n == infinitely ? 0ull : 1ull;
 
   try {
-    for (; _i < _n; _i += step) {
+    for (size_t ticked = 0; _i < _n; _i += step, ++ticked) {
+      if (!proceed(ticked))
+        return status::running;
+
       auto status = (*_childs.front())();
 
       switch (status) {
@@ -259,6 +582,12 @@ status retry::tick() {
   return status::failure;
 }
 
+void retry::stop() {
+  if (!_childs.empty() && _childs.front())
+    _childs.front()->halt();
+  reset();
+}
+
 void retry::reset() { _i = 0; }
 
 // force
@@ -280,10 +609,135 @@ status force::tick() {
   return _status;
 }
 
+void force::stop() {
+  if (!_childs.empty() && _childs.front())
+    _childs.front()->halt();
+}
+
+// reactive
+reactive::reactive(std::string_view name) : base(node_type::reactive, name) {}
+
+status reactive::tick() {
+  if (_childs.empty() || !_childs.front())
+    throw std::runtime_error(
+        "There is no controllable node under the 'reactive' node");
+
+  collect();
+
+  if (_status != status::running && !dirty())
+    return _status;
+
+  // Changes made during the tick are detected by the next tick
+  for (auto &in : _inputs)
+    in.version = in.source->version();
+
+  try {
+    _status = (*_childs.front())();
+  } catch (...) {
+    _status = status::running;
+    throw;
+  }
+
+  return _status;
+}
+
+void reactive::stop() {
+  if (!_childs.empty() && _childs.front())
+    _childs.front()->halt();
+  _status = status::running;
+}
+
+void reactive::reserve() {
+  base::reserve();
+  if (!_childs.empty() && _childs.front())
+    collect();
+}
+
+void reactive::collect() {
+  // The inputs are collected on the first tick unless the node is prepared
+  if (_collected)
+    return;
+  collect(*_childs.front());
+  _collected = true;
+}
+
+bool reactive::dirty() const {
+  for (auto const &in : _inputs) {
+    if (in.source->version() != in.version)
+      return true;
+  }
+  return false;
+}
+
+void reactive::collect(node const &ref) {
+  switch (ref.type()) {
+  case node_type::action:
+  case node_type::custom:
+    break;
+  case node_type::condition:
+    for (auto in : static_cast<condition const &>(ref).inputs())
+      watch(*in);
+    break;
+  case node_type::switch_: {
+    auto const &stmt = static_cast<switch_ const &>(ref);
+    for (auto &&case_ : stmt) {
+      collect(*case_.condition());
+      collect(*case_.handler());
+    }
+    if (stmt.default_handler())
+      collect(*stmt.default_handler());
+    break;
+  }
+  default:
+    for (auto const &child : static_cast<basic_control const &>(ref).childs()) {
+      if (child)
+        collect(*child);
+    }
+    break;
+  }
+}
+
+void reactive::watch(input const &in) {
+  for (auto const &w : _inputs) {
+    if (w.source == &in)
+      return;
+  }
+  _inputs.push_back({&in, in.version()});
+}
+
 // action
-status action::tick() { return _fn(); }
+action::action(std::string_view name, status (*fn)(void *), void *context)
+    : execution(node_type::action, name), _fn(fn, context) {}
+
+action::handler const &action::fn() const { return _fn; }
+
+action::halt_handler const &action::halt_fn() const { return _halt; }
+
+status action::tick() {
+  _running = false;
+  status const st = _fn();
+  _running = st == status::running;
+  return st;
+}
+
+void action::stop() {
+  if (!_running)
+    return;
+  _running = false;
+  if (_halt)
+    _halt();
+}
 
 // condition
+condition::condition(std::string_view name, bool (*fn)(void *), void *context,
+                     inputs_list inputs)
+    : execution(node_type::condition, name), _predicate(fn, context),
+      _inputs(std::move(inputs)) {}
+
+condition::predicate const &condition::fn() const { return _predicate; }
+
+condition::inputs_list const &condition::inputs() const { return _inputs; }
+
 status condition::tick() {
   return _predicate() ? status::success : status::failure;
 }
@@ -308,6 +762,27 @@ node::ptr if_::else_() const {
   return _childs.size() < idx + 1 ? node::ptr{} : _childs[idx];
 }
 
+if_ &if_::condition(node::ptr node) {
+  set(static_cast<size_t>(state::condition_state), std::move(node));
+  return *this;
+}
+
+if_ &if_::then_(node::ptr node) {
+  set(static_cast<size_t>(state::then_state), std::move(node));
+  return *this;
+}
+
+if_ &if_::else_(node::ptr node) {
+  set(static_cast<size_t>(state::else_state), std::move(node));
+  return *this;
+}
+
+void if_::set(size_t idx, node::ptr node) {
+  if (_childs.size() < idx + 1)
+    _childs.resize(idx + 1);
+  _childs[idx] = std::move(node);
+}
+
 status if_::tick() {
   if (!condition())
     throw std::runtime_error("There is no condition node under the 'if' node");
@@ -315,6 +790,7 @@ status if_::tick() {
   status st = status::failure;
 
   try {
+    size_t ticked = 0;
     do {
       size_t const idx = static_cast<size_t>(_state);
 
@@ -323,6 +799,9 @@ status if_::tick() {
         return status::failure;
       }
 
+      if (!proceed(ticked++))
+        return status::running;
+
       st = (*_childs[idx])();
 
       switch (st) {
@@ -349,12 +828,35 @@ status if_::tick() {
   return st;
 }
 
+void if_::stop() {
+  size_t const idx = static_cast<size_t>(_state);
+  if (idx < _childs.size() && _childs[idx])
+    _childs[idx]->halt();
+  reset();
+}
+
 void if_::reset() { _state = state::condition_state; }
 
 // switch_
 case_proxy::case_proxy(switch_ &stmt)
     : _switch(stmt), _handler(stmt._handlers.size()) {}
 
+case_proxy case_proxy::case_(node::ptr condition) && {
+  _switch.add_case(_handler);
+  try {
+    _switch._childs.emplace_back(std::move(condition));
+  } catch (...) {
+    _switch._map.pop_back();
+    throw;
+  }
+  return *this;
+}
+
+switch_ &case_proxy::handler(node::ptr node) && {
+  _switch._handlers.emplace_back(std::move(node));
+  return _switch;
+}
+
 case_::case_(node::cptr const &condition, node::cptr const &handler)
     : _condition(condition), _handler(handler) {}
 
@@ -398,6 +900,68 @@ node::cptr switch_::default_handler() const { return _default_handler; }
 switch_::iterator switch_::begin() const { return iterator(*this, true); }
 switch_::iterator switch_::end() const { return iterator(*this, false); }
 bool switch_::empty() const { return !_default_handler && _childs.empty(); }
+bool switch_::keyed() const { return static_cast<bool>(_key); }
+switch_::keys_list const &switch_::keys() const { return _keys; }
+
+case_proxy switch_::case_(node::ptr condition) {
+  return case_proxy(*this).case_(std::move(condition));
+}
+
+switch_ &switch_::default_(node::ptr node) {
+  _default_handler = std::move(node);
+  return *this;
+}
+
+struct switch_::key_source {
+  using label = std::array<char, 24>;
+  using labels_list = std::deque<label, allocator<label>>;
+
+  key_extractor extractor;
+  labels_list labels;
+};
+
+void switch_::set_key(key_extractor &&extractor) {
+  _key = std::allocate_shared<key_source>(allocator<key_source>());
+  _key->extractor = std::move(extractor);
+}
+
+void switch_::add_case(size_t handler) {
+  if (_key)
+    throw std::runtime_error(
+        "The cases of the keyed switch must be labelled with values");
+  _map.emplace_back(handler);
+}
+
+void switch_::add_case(key value, size_t handler) {
+  if (!_key)
+    throw std::runtime_error(
+        "The switch has no key extractor for the labelled cases");
+
+  // The node names are not owned by the nodes, so the labels are kept along
+  // with the key extractor
+  auto &label = _key->labels.emplace_back();
+  auto const result =
+      std::to_chars(label.data(), label.data() + label.size(), value);
+  std::string_view const name(label.data(), result.ptr - label.data());
+
+  auto predicate = [source = _key, value] {
+    return source->extractor() == value;
+  };
+
+  try {
+    _childs.reserve(_childs.size() + 1);
+    _map.reserve(_map.size() + 1);
+    _keys.reserve(_keys.size() + 1);
+
+    _childs.emplace_back(make_node<condition>(name, std::move(predicate)));
+  } catch (...) {
+    _key->labels.pop_back();
+    throw;
+  }
+
+  _map.emplace_back(handler);
+  _keys.emplace_back(value);
+}
 
 status switch_::tick() {
   if (_childs.size() != _map.size())
@@ -406,87 +970,221 @@ status switch_::tick() {
 
   status st = status::failure;
 
+  allocate_state();
+
   try {
+    size_t ticked = 0;
+
     if (_state == state::match) {
-      st = match();
+      st = _key ? dispatch() : match(ticked);
     }
 
     if (_state == state::exec) {
-      st = exec();
+      st = exec(ticked);
     }
 
     if (st != status::running)
       reset();
   } catch (...) {
-    reset();
+    stop();
     throw;
   }
 
   return st;
 }
 
+void switch_::stop() {
+  if (_state == state::match) {
+    for (size_t i = 0; i < _match_statuses.size(); ++i) {
+      if (_match_statuses[i] == status::running)
+        _childs[i]->halt();
+    }
+  } else if (!_handler_statuses.empty()) {
+    for (auto &&[handler_idx, handler_status] : _handler_statuses) {
+      if (handler_status == status::running)
+        _handlers[handler_idx]->halt();
+    }
+  } else if (_default_handler) {
+    _default_handler->halt();
+  }
+  reset();
+}
+
+void switch_::reserve() {
+  base::reserve();
+  for (auto const &handler : _handlers) {
+    if (handler)
+      handler->prepare();
+  }
+  if (_default_handler)
+    _default_handler->prepare();
+  allocate_state();
+}
+
+void switch_::allocate_state() {
+  // The execution state is allocated on the first tick unless it's prepared
+  if (_key) {
+    if (_indexed != _keys.size())
+      index();
+  } else {
+    _match_statuses.reserve(_childs.size());
+  }
+  _handler_statuses.reserve(_handlers.size());
+}
+
 void switch_::reset() {
   _state = state::match;
   _match_statuses.clear();
   _handler_statuses.clear();
+  _next = 0;
 }
 
-status switch_::match() {
+status switch_::match(size_t &ticked) {
   _match_statuses.resize(_childs.size(), status::running);
 
-  // Collect matched cases
-  std::vector<size_t> matched;
-  matched.reserve(_childs.size());
-
   size_t running = {};
+  size_t matched = {};
+  size_t const count = _childs.size();
+  bool paused = false;
 
-  for (size_t i = 0; i < _childs.size(); ++i) {
-    auto &child = _childs[i];
+  for (size_t k = 0; k < count; ++k) {
+    size_t const i = _next + k < count ? _next + k : _next + k - count;
     auto &st = _match_statuses[i];
 
-    if (st == status::running)
-      st = (*child)();
+    if (st == status::running && !paused) {
+      if (proceed(ticked++)) {
+        st = (*_childs[i])();
+      } else {
+        paused = true;
+        _next = i;
+      }
+    }
     if (st == status::running)
       ++running;
     else if (st == status::success)
-      matched.emplace_back(i);
+      ++matched;
   }
 
   if (running)
     return status::running;
 
-  if (!matched.empty()) {
-    _handler_statuses.reserve(_handlers.size());
+  if (matched) {
+    // Collect the matched handlers, the same handler is executed once
+    size_t mapped_handler = std::numeric_limits<size_t>::max();
 
-    size_t mapped_handler = _map.at(matched.front());
-    _handler_statuses.emplace_back(mapped_handler, status::running);
-
-    for (size_t i = 1; i < matched.size(); ++i) {
-      size_t handler = _map.at(matched[i]);
-      if (mapped_handler != handler) {
-        mapped_handler = handler;
-        _handler_statuses.emplace_back(mapped_handler, status::running);
-      }
+    for (size_t i = 0; i < _childs.size(); ++i) {
+      if (_match_statuses[i] != status::success || mapped_handler == _map[i])
+        continue;
+      mapped_handler = _map[i];
+      _handler_statuses.emplace_back(mapped_handler, status::running);
     }
 
     _match_statuses.clear();
   }
 
   _state = state::exec;
+  _next = 0;
 
   return status::success;
 }
 
-status switch_::exec() {
+status switch_::dispatch() {
+  key const value = _key->extractor();
+  span matched = {};
+
+  if (!_jump.empty()) {
+    auto const offset = static_cast<std::uint64_t>(value) -
+                        static_cast<std::uint64_t>(_min);
+    if (offset < _jump.size())
+      matched = _jump[offset];
+  } else if (auto it = _hash.find(value); it != _hash.end()) {
+    matched = it->second;
+  }
+
+  for (size_t i = matched.first; i < matched.second; ++i)
+    _handler_statuses.emplace_back(_targets[i], status::running);
+
+  _state = state::exec;
+
+  return status::success;
+}
+
+void switch_::index() {
+  // Group the cases by values keeping the order of the cases in each group
+  handlers_map order(_keys.size());
+  std::iota(order.begin(), order.end(), size_t{});
+  std::stable_sort(order.begin(), order.end(),
+                   [this](size_t lhs, size_t rhs) {
+                     return _keys[lhs] < _keys[rhs];
+                   });
+
+  size_t values = {};
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || _keys[order[i]] != _keys[order[i - 1]])
+      ++values;
+  }
+
+  _targets.clear();
+  _jump.clear();
+  _hash.clear();
+  _min = order.empty() ? key{} : _keys[order.front()];
+
+  // The jump table is used if at least a quarter of its slots is occupied
+  auto const range = order.empty()
+                         ? std::uint64_t{}
+                         : static_cast<std::uint64_t>(_keys[order.back()]) -
+                               static_cast<std::uint64_t>(_min);
+  bool const dense = values != 0 && range < values * 4;
+
+  if (dense)
+    _jump.resize(static_cast<size_t>(range) + 1);
+  else
+    _hash.reserve(values);
+
+  for (size_t i = 0; i < order.size();) {
+    key const value = _keys[order[i]];
+    span targets(_targets.size(), _targets.size());
+
+    // The same handler is executed once
+    for (; i < order.size() && _keys[order[i]] == value; ++i) {
+      size_t const handler = _map[order[i]];
+      if (targets.second == targets.first || _targets.back() != handler) {
+        _targets.emplace_back(handler);
+        ++targets.second;
+      }
+    }
+
+    if (dense)
+      _jump[static_cast<std::uint64_t>(value) -
+            static_cast<std::uint64_t>(_min)] = targets;
+    else
+      _hash.emplace(value, targets);
+  }
+
+  _indexed = _keys.size();
+}
+
+status switch_::exec(size_t &ticked) {
   status st = status::failure;
 
   if (!_handler_statuses.empty()) { // execute matched handlers
     size_t running = {};
     size_t failed = {};
-
-    for (auto &&[handler_idx, handler_status] : _handler_statuses) {
-      if (handler_status == status::running)
-        handler_status = (*_handlers.at(handler_idx))();
+    size_t const count = _handler_statuses.size();
+    bool paused = false;
+
+    for (size_t k = 0; k < count; ++k) {
+      size_t const i = _next + k < count ? _next + k : _next + k - count;
+      auto &[handler_idx, handler_status] = _handler_statuses[i];
+
+      if (handler_status == status::running && !paused) {
+        if (proceed(ticked++)) {
+          handler_status = (*_handlers.at(handler_idx))();
+        } else {
+          paused = true;
+          _next = i;
+        }
+      }
       if (handler_status == status::running)
         ++running;
       if (handler_status == status::failure)
@@ -498,6 +1196,8 @@ status switch_::exec() {
                        : status::success;
   } else { // execute default handler
     if (_default_handler) {
+      if (!proceed(ticked++))
+        return status::running;
       st = (*_default_handler)();
     } else {
       st = status::failure;
@@ -21,15 +21,28 @@
  */
 
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <new>
 #include <limits>
 #include <memory>
+#include <memory_resource>
 #include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#ifndef BHVT_INLINE_CAPACITY
+/**
+ * @brief Size of the inline storage for the leaf callables
+ */
+#define BHVT_INLINE_CAPACITY 64
+#endif
+
 namespace cppttl {
 namespace bhv {
 
@@ -53,12 +66,106 @@ enum class node_type {
   repeat,
   retry,
   force,
+  reactive,
   custom
 };
 
 char const *to_string(status);
 char const *to_string(node_type);
 
+/**
+ * @brief Memory resource used for the nodes and the child lists allocation on
+ * the calling thread. The default resource is std::pmr::get_default_resource().
+ */
+std::pmr::memory_resource *get_memory_resource();
+
+/**
+ * @brief Set the memory resource for the nodes allocation on the calling thread
+ *
+ * @param [in] resource               New memory resource or nullptr for default
+ * @return std::pmr::memory_resource*   Previous memory resource or nullptr
+ */
+std::pmr::memory_resource *
+set_memory_resource(std::pmr::memory_resource *resource);
+
+/**
+ * @brief The allocator bound to the memory resource of the calling thread at
+ * the moment of the container construction.
+ */
+template <typename T>
+class allocator : public std::pmr::polymorphic_allocator<T> {
+public:
+  using base = std::pmr::polymorphic_allocator<T>;
+
+  template <typename U> struct rebind {
+    using other = allocator<U>;
+  };
+
+  allocator() : base(get_memory_resource()) {}
+  allocator(std::pmr::memory_resource *resource) : base(resource) {}
+  allocator(allocator const &) = default;
+  template <typename U>
+  allocator(allocator<U> const &other) : base(other.resource()) {}
+
+  allocator select_on_container_copy_construction() const {
+    return allocator();
+  }
+};
+
+/**
+ * @brief Create a node using the memory resource of the calling thread
+ */
+template <typename Node, typename... Args>
+std::shared_ptr<Node> make_node(Args &&...args) {
+  return std::allocate_shared<Node>(allocator<Node>(),
+                                    std::forward<Args>(args)...);
+}
+
+class executor;
+
+/**
+ * @brief Move-only callable wrapper with inline storage.
+ * The callable is always stored inside the wrapper, so it never allocates.
+ * Callables which don't fit into the storage are rejected at compile time.
+ * The wrapper can also hold a plain function pointer with a context pointer.
+ */
+template <typename Signature, size_t Capacity = BHVT_INLINE_CAPACITY>
+class inplace_function;
+
+/**
+ * @brief The budget of the tick limits the work done by a single tick.
+ *
+ * Control nodes and decorators spend one step of the budget every time they
+ * proceed to the next child or iteration within the tick. Once the budget is
+ * exhausted, they return running and resume from the saved position on the
+ * next tick. The first child of every node is ticked regardless of the budget,
+ * so the tree always makes progress. The budget is limited by the number of
+ * steps (quota), by the deadline or both.
+ */
+class tick_budget {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+
+  explicit tick_budget(size_t quota);
+  explicit tick_budget(clock::duration timeout, size_t quota = unlimited);
+  explicit tick_budget(clock::time_point deadline, size_t quota = unlimited);
+
+  /**
+   * @brief Spend one step
+   * @return false  The budget is exhausted
+   */
+  bool spend();
+  bool exhausted() const;
+
+private:
+  clock::time_point _deadline;
+  size_t _quota;
+  bool _timed;
+  bool _exhausted = false;
+};
+
 /**
  * @brief The base class of all nodes.
  */
@@ -70,16 +177,83 @@ public:
   node(node_type type, std::string_view name);
   virtual ~node();
   status operator()();
+
+  /**
+   * @brief Tick the node within the budget. The budget applies to the whole
+   * subtree except the children ticked concurrently on executors.
+   */
+  status operator()(tick_budget &budget);
+
+  /**
+   * @brief Stop the running node and reset its state.
+   * Control nodes and decorators halt their running children, so the abandoned
+   * subtree is stopped completely. Halting an idle node does nothing.
+   */
+  void halt();
+
+  /**
+   * @brief Allocate the execution state of the subtree in advance, so the ticks
+   * don't allocate it. Otherwise the state is allocated on the first ticks.
+   */
+  void prepare();
+
   node_type type() const;
   std::string_view name() const;
 
 private:
   virtual status tick() = 0;
+  virtual void stop();
+  virtual void reserve();
 
   node_type _type;
   std::string_view _name;
 };
 
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// inputs
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * @brief The input read by conditions. Every change of the input increments
+ * its version, so the reactive nodes can detect the changes.
+ */
+class input {
+public:
+  input() = default;
+  input(input const &) = delete;
+  input &operator=(input const &) = delete;
+
+  /**
+   * @brief Notify the dependent nodes that the input has changed
+   */
+  void notify();
+  std::uint64_t version() const;
+
+private:
+  std::atomic<std::uint64_t> _version{};
+};
+
+/**
+ * @brief The input holding a value. Setting a different value notifies the
+ * dependent nodes.
+ */
+template <typename T> class value : public input {
+public:
+  value(T v = {}) : _value(std::move(v)) {}
+
+  T const &get() const { return _value; }
+
+  void set(T v) {
+    if (v == _value)
+      return;
+    _value = std::move(v);
+    notify();
+  }
+
+private:
+  T _value;
+};
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // control nodes
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -93,12 +267,15 @@ private:
  */
 class basic_control : public node {
 public:
-  using childs_list = std::vector<node::ptr>;
+  using childs_list = std::vector<node::ptr, allocator<node::ptr>>;
 
   using node::node;
 
   childs_list const &childs() const;
 
+protected:
+  void reserve() override;
+
 protected:
   childs_list _childs;
 };
@@ -109,19 +286,25 @@ public:
 
   template <typename Node, typename... Args> Impl &add(Args &&...args);
   template <typename T, typename Node = std::decay_t<T>> Impl &add(T &&node);
+  Impl &add(node::ptr node);
 };
 
 template <typename Impl>
 template <typename Node, typename... Args>
 Impl &control<Impl>::add(Args &&...args) {
-  _childs.emplace_back(std::make_shared<Node>(std::forward<Args>(args)...));
+  _childs.emplace_back(make_node<Node>(std::forward<Args>(args)...));
   return static_cast<Impl &>(*this);
 }
 
 template <typename Impl>
 template <typename T, typename Node>
 Impl &control<Impl>::add(T &&node) {
-  _childs.emplace_back(std::make_shared<Node>(std::forward<T>(node)));
+  _childs.emplace_back(make_node<Node>(std::forward<T>(node)));
+  return static_cast<Impl &>(*this);
+}
+
+template <typename Impl> Impl &control<Impl>::add(node::ptr node) {
+  _childs.emplace_back(std::move(node));
   return static_cast<Impl &>(*this);
 }
 
@@ -138,6 +321,7 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
   void reset();
 
 private:
@@ -157,6 +341,7 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
   void reset();
 
 private:
@@ -167,23 +352,38 @@ private:
 /**
  * @brief The parallel node executes all the child nodes until at least M nodes
  * succeed, otherwise it fails.
+ *
+ * If the executor is specified, the child nodes are ticked concurrently on it.
+ * The tick is completed as soon as the outcome is decided: the child ticks that
+ * haven't started yet are skipped and the tick waits only for the child ticks
+ * already in progress.
+ *
+ * Once the outcome is decided, the children which are still running are
+ * halted.
  */
 class parallel : public control<parallel> {
 public:
   using base = control<parallel>;
 
   parallel(std::string_view name, size_t threshold);
+  parallel(std::string_view name, size_t threshold, executor &ex);
   size_t threshold() const;
 
 private:
   status tick() final;
+  void stop() final;
+  void reserve() final;
+  status tick_concurrently();
+  void halt_running();
   void reset();
 
 private:
-  using statuses = std::vector<status>;
+  using statuses = std::vector<status, allocator<status>>;
 
   size_t _threshold;
   statuses _statuses;
+  size_t _next{}; // The child ticked first, it's moved by the tick budget
+  executor *_executor = nullptr;
 };
 
 // if/then/else
@@ -205,16 +405,21 @@ public:
   template <typename T, typename Node = std::decay_t<T>>
   if_ &condition(T &&node);
   template <typename Node, typename... Args> if_ &condition(Args &&...args);
+  if_ &condition(node::ptr node);
 
   template <typename T, typename Node = std::decay_t<T>> if_ &then_(T &&node);
   template <typename Node, typename... Args> if_ &then_(Args &&...args);
+  if_ &then_(node::ptr node);
 
   template <typename T, typename Node = std::decay_t<T>> if_ &else_(T &&node);
   template <typename Node, typename... Args> if_ &else_(Args &&...args);
+  if_ &else_(node::ptr node);
 
 private:
   status tick() final;
+  void stop() final;
   void reset();
+  void set(size_t idx, node::ptr node);
 
 private:
   enum class state : size_t {
@@ -237,7 +442,7 @@ template <typename T, typename Node> if_ &if_::condition(T &&node) {
   size_t const idx = static_cast<size_t>(state::condition_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<T>(node));
+  _childs[idx] = make_node<Node>(std::forward<T>(node));
   return *this;
 }
 
@@ -245,7 +450,7 @@ template <typename Node, typename... Args> if_ &if_::condition(Args &&...args) {
   size_t const idx = static_cast<size_t>(state::condition_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<Args>(args)...);
+  _childs[idx] = make_node<Node>(std::forward<Args>(args)...);
   return *this;
 }
 
@@ -253,7 +458,7 @@ template <typename T, typename Node> if_ &if_::then_(T &&node) {
   size_t const idx = static_cast<size_t>(state::then_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<T>(node));
+  _childs[idx] = make_node<Node>(std::forward<T>(node));
   return *this;
 }
 
@@ -261,7 +466,7 @@ template <typename Node, typename... Args> if_ &if_::then_(Args &&...args) {
   size_t const idx = static_cast<size_t>(state::then_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<Args>(args)...);
+  _childs[idx] = make_node<Node>(std::forward<Args>(args)...);
   return *this;
 }
 
@@ -269,7 +474,7 @@ template <typename T, typename Node> if_ &if_::else_(T &&node) {
   size_t const idx = static_cast<size_t>(state::else_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<T>(node));
+  _childs[idx] = make_node<Node>(std::forward<T>(node));
   return *this;
 }
 
@@ -277,7 +482,7 @@ template <typename Node, typename... Args> if_ &if_::else_(Args &&...args) {
   size_t const idx = static_cast<size_t>(state::else_state);
   if (_childs.size() < idx + 1)
     _childs.resize(idx + 1);
-  _childs[idx] = std::make_shared<Node>(std::forward<Args>(args)...);
+  _childs[idx] = make_node<Node>(std::forward<Args>(args)...);
   return *this;
 }
 
@@ -289,6 +494,23 @@ template <typename Node, typename... Args> if_ &if_::else_(Args &&...args) {
  */
 class switch_;
 
+/**
+ * @brief The key of the keyed switch. Integral and enumeration values are
+ * converted to this type.
+ */
+using switch_key = std::int64_t;
+
+template <typename K>
+constexpr auto is_switch_key_v = std::is_integral_v<K> || std::is_enum_v<K>;
+
+template <typename K> constexpr switch_key to_switch_key(K value) {
+  if constexpr (std::is_enum_v<K>)
+    return static_cast<switch_key>(
+        static_cast<std::underlying_type_t<K>>(value));
+  else
+    return static_cast<switch_key>(value);
+}
+
 class case_proxy {
 private:
   case_proxy(switch_ &stmt);
@@ -297,15 +519,20 @@ public:
   case_proxy(case_proxy const &) = default;
   case_proxy(case_proxy &&) = default;
 
-  template <typename Cond, typename Condition = std::decay_t<Cond>>
+  template <typename Cond, typename Condition = std::decay_t<Cond>,
+            typename = std::enable_if_t<!is_switch_key_v<Condition>>>
   case_proxy case_(Cond &&condition) &&;
   template <typename Cond, typename... Args>
   case_proxy case_(Args &&...args) &&;
+  template <typename Key, typename = std::enable_if_t<is_switch_key_v<Key>>>
+  case_proxy case_(Key value) &&;
+  case_proxy case_(node::ptr condition) &&;
 
   template <typename T, typename Node = std::decay_t<T>>
   switch_ &handler(T &&node) &&;
   template <typename Node, typename... Args>
   switch_ &handler(Args &&...args) &&;
+  switch_ &handler(node::ptr node) &&;
 
 private:
   switch_ &_switch;
@@ -328,9 +555,20 @@ private:
   node::cptr _handler;
 };
 
+/**
+ * @brief The keyed switch evaluates the key extractor once and dispatches to
+ * the handlers of the cases labelled with the key value through the table
+ * built on the first tick: a jump table for dense keys and a hash table
+ * otherwise. Every case is still represented by a condition comparing the key
+ * with the value, so the keyed switch is ticked by flat trees and serialized
+ * like the regular one.
+ */
 class switch_ : public basic_control {
 public:
   using base = basic_control;
+  using key = switch_key;
+  using key_extractor = inplace_function<key()>;
+  using keys_list = std::vector<key, allocator<key>>;
 
   class iterator {
   public:
@@ -349,15 +587,30 @@ public:
   };
 
   switch_(std::string_view name);
+  template <typename Fn, typename K = std::invoke_result_t<Fn &>,
+            typename = std::enable_if_t<is_switch_key_v<K>>>
+  switch_(std::string_view name, Fn &&key);
 
-  template <typename C> case_proxy case_(C &&condition);
+  template <typename C,
+            typename = std::enable_if_t<!is_switch_key_v<std::decay_t<C>>>>
+  case_proxy case_(C &&condition);
   template <typename C, typename... Args> case_proxy case_(Args &&...args);
+  template <typename Key, typename = std::enable_if_t<is_switch_key_v<Key>>>
+  case_proxy case_(Key value);
+  case_proxy case_(node::ptr condition);
 
   template <typename T, typename Node = std::decay_t<T>>
   switch_ &default_(T &&node);
   template <typename Node, typename... Args> switch_ &default_(Args &&...args);
+  switch_ &default_(node::ptr node);
 
   node::cptr default_handler() const;
+  bool keyed() const;
+
+  /**
+   * @brief The values of the keyed switch cases
+   */
+  keys_list const &keys() const;
 
   iterator begin() const;
   iterator end() const;
@@ -365,30 +618,66 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
+  void reserve() final;
   void reset();
-  status match();
-  status exec();
+  void allocate_state();
+  status match(size_t &ticked);
+  status dispatch();
+  status exec(size_t &ticked);
+
+  void set_key(key_extractor &&extractor);
+  void add_case(size_t handler);
+  void add_case(key value, size_t handler);
+  void index();
 
 private:
   enum class state : size_t { match, exec };
 
-  using handlers_map = std::vector<size_t>;
-  using statuses = std::vector<status>;
-  using handler_statuses = std::vector<std::pair<size_t, status>>;
+  using handlers_map = std::vector<size_t, allocator<size_t>>;
+  using statuses = std::vector<status, allocator<status>>;
+  using handler_statuses = std::vector<std::pair<size_t, status>,
+                                       allocator<std::pair<size_t, status>>>;
 
   state _state = state::match;
   statuses _match_statuses;
   handler_statuses _handler_statuses;
+  size_t _next{}; // The case or handler ticked first, moved by the tick budget
 
   childs_list _handlers;
   node::ptr _default_handler;
   handlers_map _map;
 
+  // The keyed switch
+  using span = std::pair<size_t, size_t>;
+  using jump_table = std::vector<span, allocator<span>>;
+  using hash_table =
+      std::unordered_map<key, span, std::hash<key>, std::equal_to<key>,
+                         allocator<std::pair<key const, span>>>;
+
+  // The key extractor and the case labels shared with the case conditions
+  struct key_source;
+
+  std::shared_ptr<key_source> _key;
+  keys_list _keys;       // Case values
+  handlers_map _targets; // Handlers grouped by the case values
+  jump_table _jump;      // Spans of _targets indexed by the key - _min
+  hash_table _hash;      // Spans of _targets for sparse keys
+  key _min{};
+  size_t _indexed{}; // Number of the cases in the table
+
   friend class case_proxy;
   friend class case_;
 };
 
-template <typename C> case_proxy switch_::case_(C &&condition) {
+template <typename Fn, typename K, typename>
+switch_::switch_(std::string_view name, Fn &&key) : switch_(name) {
+  set_key([fn = std::forward<Fn>(key)]() mutable {
+    return to_switch_key(fn());
+  });
+}
+
+template <typename C, typename> case_proxy switch_::case_(C &&condition) {
   return case_proxy(*this).case_<C>(std::forward<C>(condition));
 }
 
@@ -397,23 +686,27 @@ case_proxy switch_::case_(Args &&...args) {
   return case_proxy(*this).case_<C, Args...>(std::forward<Args>(args)...);
 }
 
+template <typename Key, typename> case_proxy switch_::case_(Key value) {
+  return case_proxy(*this).case_(value);
+}
+
 template <typename T, typename Node> switch_ &switch_::default_(T &&node) {
-  _default_handler = std::make_shared<Node>(std::forward<T>(node));
+  _default_handler = make_node<Node>(std::forward<T>(node));
   return *this;
 }
 
 template <typename Node, typename... Args>
 switch_ &switch_::default_(Args &&...args) {
-  _default_handler = std::make_shared<Node>(std::forward<Args>(args)...);
+  _default_handler = make_node<Node>(std::forward<Args>(args)...);
   return *this;
 }
 
-template <typename Cond, typename Condition>
+template <typename Cond, typename Condition, typename>
 case_proxy case_proxy::case_(Cond &&condition) && {
-  _switch._map.emplace_back(_handler);
+  _switch.add_case(_handler);
   try {
     _switch._childs.emplace_back(
-        std::make_shared<Condition>(std::forward<Cond>(condition)));
+        make_node<Condition>(std::forward<Cond>(condition)));
   } catch (...) {
     _switch._map.pop_back();
     throw;
@@ -423,10 +716,10 @@ case_proxy case_proxy::case_(Cond &&condition) && {
 
 template <typename C, typename... Args>
 case_proxy case_proxy::case_(Args &&...args) && {
-  _switch._map.emplace_back(_handler);
+  _switch.add_case(_handler);
   try {
     _switch._childs.emplace_back(
-        std::make_shared<C>(std::forward<Args>(args)...));
+        make_node<C>(std::forward<Args>(args)...));
   } catch (...) {
     _switch._map.pop_back();
     throw;
@@ -434,15 +727,21 @@ case_proxy case_proxy::case_(Args &&...args) && {
   return *this;
 }
 
+template <typename Key, typename>
+case_proxy case_proxy::case_(Key value) && {
+  _switch.add_case(to_switch_key(value), _handler);
+  return *this;
+}
+
 template <typename T, typename Node> switch_ &case_proxy::handler(T &&node) && {
-  _switch._handlers.emplace_back(std::make_shared<Node>(std::forward<T>(node)));
+  _switch._handlers.emplace_back(make_node<Node>(std::forward<T>(node)));
   return _switch;
 }
 
 template <typename Node, typename... Args>
 switch_ &case_proxy::handler(Args &&...args) && {
   _switch._handlers.emplace_back(
-      std::make_shared<Node>(std::forward<Args>(args)...));
+      make_node<Node>(std::forward<Args>(args)...));
   return _switch;
 }
 
@@ -460,13 +759,14 @@ public:
 
   template <typename Node, typename... Args> Impl &child(Args &&...args);
   template <typename T, typename Node = std::decay_t<T>> Impl &child(T &&node);
+  Impl &child(node::ptr node);
 };
 
 template <typename Impl>
 template <typename Node, typename... Args>
 Impl &decorator<Impl>::child(Args &&...args) {
   _childs.resize(1);
-  node::ptr child = std::make_shared<Node>(std::forward<Args>(args)...);
+  node::ptr child = make_node<Node>(std::forward<Args>(args)...);
   std::swap(_childs.front(), child);
   return static_cast<Impl &>(*this);
 }
@@ -475,11 +775,17 @@ template <typename Impl>
 template <typename T, typename Node>
 Impl &decorator<Impl>::child(T &&node) {
   _childs.resize(1);
-  node::ptr child = std::make_shared<Node>(std::forward<T>(node));
+  node::ptr child = make_node<Node>(std::forward<T>(node));
   std::swap(_childs.front(), child);
   return static_cast<Impl &>(*this);
 }
 
+template <typename Impl> Impl &decorator<Impl>::child(node::ptr node) {
+  _childs.resize(1);
+  std::swap(_childs.front(), node);
+  return static_cast<Impl &>(*this);
+}
+
 /**
  * @brief A node for inverting the child result.
  */
@@ -491,6 +797,7 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
 };
 
 /**
@@ -508,6 +815,7 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
   void reset();
 
 private:
@@ -530,6 +838,7 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
   void reset();
 
 private:
@@ -550,15 +859,183 @@ public:
 
 private:
   status tick() final;
+  void stop() final;
 
 private:
   status const _status;
 };
 
+/**
+ * @brief Re-evaluate the child only if it's running or if the inputs read by
+ * the conditions of the subtree have changed since the last evaluation.
+ * Otherwise the last status is returned without ticking the subtree.
+ *
+ * The inputs are collected from the subtree on the first tick, so the subtree
+ * must not be modified afterwards.
+ */
+class reactive : public decorator<reactive> {
+public:
+  using base = decorator<reactive>;
+
+  reactive(std::string_view name);
+
+private:
+  status tick() final;
+  void stop() final;
+  void reserve() final;
+  void collect();
+  bool dirty() const;
+  void collect(node const &ref);
+  void watch(input const &in);
+
+private:
+  struct watched {
+    input const *source;
+    std::uint64_t version;
+  };
+
+  using watch_list = std::vector<watched, allocator<watched>>;
+
+  watch_list _inputs;
+  status _status = status::running;
+  bool _collected = false;
+};
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // execution nodes
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+template <typename R, typename... Args, size_t Capacity>
+class inplace_function<R(Args...), Capacity> {
+public:
+  using function_ptr = R (*)(void *, Args...);
+
+  inplace_function() noexcept = default;
+  inplace_function(std::nullptr_t) noexcept {}
+
+  template <typename Fn, typename F = std::decay_t<Fn>,
+            typename = std::enable_if_t<
+                !std::is_same_v<F, inplace_function> &&
+                std::is_invocable_r_v<R, F &, Args...>>>
+  inplace_function(Fn &&fn);
+
+  inplace_function(function_ptr fn, void *context) noexcept;
+
+  inplace_function(inplace_function &&other) noexcept;
+  inplace_function &operator=(inplace_function &&other) noexcept;
+  inplace_function(inplace_function const &) = delete;
+  inplace_function &operator=(inplace_function const &) = delete;
+  ~inplace_function();
+
+  R operator()(Args... args) const;
+  explicit operator bool() const noexcept;
+
+private:
+  // Move the callable from src to dst or destroy src if dst is null
+  using manager = void (*)(void *dst, void *src);
+
+  static R empty(void *, Args...);
+  void move(inplace_function &other) noexcept;
+  void destroy() noexcept;
+
+private:
+  function_ptr _invoke = &empty;
+  void *_object = nullptr;
+  manager _manage = nullptr;
+  alignas(std::max_align_t) unsigned char _storage[Capacity];
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Fn, typename F, typename>
+inplace_function<R(Args...), Capacity>::inplace_function(Fn &&fn) {
+  static_assert(sizeof(F) <= Capacity,
+                "The callable is too large for the inline storage");
+  static_assert(alignof(F) <= alignof(std::max_align_t),
+                "The callable alignment is not supported");
+  static_assert(std::is_nothrow_move_constructible_v<F>,
+                "The callable must be nothrow move constructible");
+
+  _object = ::new (static_cast<void *>(_storage)) F(std::forward<Fn>(fn));
+  _invoke = [](void *object, Args... args) -> R {
+    return (*static_cast<F *>(object))(std::forward<Args>(args)...);
+  };
+  _manage = [](void *dst, void *src) {
+    auto &ref = *static_cast<F *>(src);
+    if (dst)
+      ::new (dst) F(std::move(ref));
+    ref.~F();
+  };
+}
+
+template <typename R, typename... Args, size_t Capacity>
+inplace_function<R(Args...), Capacity>::inplace_function(
+    function_ptr fn, void *context) noexcept
+    : _invoke(fn ? fn : &empty), _object(context) {}
+
+template <typename R, typename... Args, size_t Capacity>
+inplace_function<R(Args...), Capacity>::inplace_function(
+    inplace_function &&other) noexcept {
+  move(other);
+}
+
+template <typename R, typename... Args, size_t Capacity>
+inplace_function<R(Args...), Capacity> &
+inplace_function<R(Args...), Capacity>::operator=(
+    inplace_function &&other) noexcept {
+  if (this != &other) {
+    destroy();
+    move(other);
+  }
+  return *this;
+}
+
+template <typename R, typename... Args, size_t Capacity>
+inplace_function<R(Args...), Capacity>::~inplace_function() {
+  destroy();
+}
+
+template <typename R, typename... Args, size_t Capacity>
+R inplace_function<R(Args...), Capacity>::operator()(Args... args) const {
+  return _invoke(_object, std::forward<Args>(args)...);
+}
+
+template <typename R, typename... Args, size_t Capacity>
+inplace_function<R(Args...), Capacity>::operator bool() const noexcept {
+  return _invoke != &empty;
+}
+
+template <typename R, typename... Args, size_t Capacity>
+R inplace_function<R(Args...), Capacity>::empty(void *, Args...) {
+  throw std::bad_function_call();
+}
+
+template <typename R, typename... Args, size_t Capacity>
+void inplace_function<R(Args...), Capacity>::move(
+    inplace_function &other) noexcept {
+  _invoke = other._invoke;
+  _manage = other._manage;
+
+  if (_manage) {
+    _manage(_storage, other._storage);
+    _object = _storage;
+  } else {
+    _object = other._object;
+  }
+
+  other._invoke = &empty;
+  other._object = nullptr;
+  other._manage = nullptr;
+}
+
+template <typename R, typename... Args, size_t Capacity>
+void inplace_function<R(Args...), Capacity>::destroy() noexcept {
+  if (_manage)
+    _manage(nullptr, _storage);
+  _invoke = &empty;
+  _object = nullptr;
+  _manage = nullptr;
+}
+
 /**
  * @brief The base class for execution nodes.
  */
@@ -576,44 +1053,80 @@ using return_t = std::enable_if_t<is_return_v<Fn, R>, R>;
  * @brief An action node performs some useful task.
  * It should return the status after execution.
  * The statuses can be as follows: running, success, failure
+ *
+ * The optional halt handler is called when the running action is halted, so
+ * the action can cancel its work and release the resources.
  */
 class action : public execution {
 public:
-  using handler = std::function<status()>;
+  using handler = inplace_function<status()>;
+  using halt_handler = inplace_function<void()>;
 
   template <typename Fn, typename R = return_t<Fn, status>>
   action(std::string_view name, Fn &&fn);
+  template <typename Fn, typename Halt,
+            typename = std::enable_if_t<std::is_invocable_v<Halt &>>,
+            typename R = return_t<Fn, status>>
+  action(std::string_view name, Fn &&fn, Halt &&halt);
+  action(std::string_view name, status (*fn)(void *), void *context);
+
+  handler const &fn() const;
+  halt_handler const &halt_fn() const;
 
 private:
   status tick() final;
+  void stop() final;
 
   handler _fn;
+  halt_handler _halt;
+  bool _running = false;
 };
 
 template <typename Fn, typename R>
 action::action(std::string_view name, Fn &&fn)
-    : execution(node_type::action, name), _fn(fn) {}
+    : execution(node_type::action, name), _fn(std::forward<Fn>(fn)) {}
+
+template <typename Fn, typename Halt, typename, typename R>
+action::action(std::string_view name, Fn &&fn, Halt &&halt)
+    : execution(node_type::action, name), _fn(std::forward<Fn>(fn)),
+      _halt(std::forward<Halt>(halt)) {}
 
 /**
  * @brief A condition node is a predicate that is very useful for branching an
  * algorithm. It can only return success or failure statuses.
+ *
+ * The condition can declare the inputs it reads, so the reactive nodes
+ * re-evaluate it only when the inputs change.
  */
 class condition : public execution {
 public:
-  using predicate = std::function<bool()>;
+  using predicate = inplace_function<bool()>;
+  using inputs_list = std::vector<input const *, allocator<input const *>>;
+
+  template <typename Fn, typename... Inputs,
+            typename = std::enable_if_t<(std::is_base_of_v<input, Inputs> &&
+                                         ...)>,
+            typename R = return_t<Fn, bool>>
+  condition(std::string_view name, Fn &&fn, Inputs const &...inputs);
+  condition(std::string_view name, bool (*fn)(void *), void *context,
+            inputs_list inputs = {});
 
-  template <typename Fn, typename R = return_t<Fn, bool>>
-  condition(std::string_view name, Fn &&fn);
+  predicate const &fn() const;
+  inputs_list const &inputs() const;
 
 private:
   status tick() final;
 
   predicate _predicate;
+  inputs_list _inputs;
 };
 
-template <typename Fn, typename R>
-condition::condition(std::string_view name, Fn &&fn)
-    : execution(node_type::condition, name), _predicate(fn) {}
+template <typename Fn, typename... Inputs, typename, typename R>
+condition::condition(std::string_view name, Fn &&fn, Inputs const &...inputs)
+    : execution(node_type::condition, name), _predicate(std::forward<Fn>(fn)) {
+  if constexpr (sizeof...(Inputs) != 0)
+    _inputs = {static_cast<input const *>(&inputs)...};
+}
 
 } // namespace bhv
 } // namespace cppttl
@@ -0,0 +1,121 @@
+#include "allocations.hpp"
+#include "catch.hpp"
+#include <bhvbatch.hpp>
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+
+using namespace cppttl;
+
+namespace {
+
+// The tree visiting all the node types and branches within several ticks
+bhv::sequence make_tree(int &t, bhv::input &in) {
+  auto step = [&t](int period) {
+    return [&t, period] {
+      int const phase = t % period;
+      return phase == 0   ? bhv::status::success
+             : phase == 1 ? bhv::status::failure
+                          : bhv::status::running;
+    };
+  };
+
+  // clang-format off
+  return bhv::sequence("root")
+    .add(bhv::parallel("par", 3)
+      .add(bhv::sequence("seq")
+           .add<bhv::condition>("c1", [&t] { return t % 2 == 0; })
+           .add<bhv::action>("a1", step(3), [] {}))
+      .add(bhv::fallback("fal")
+           .add(bhv::invert("inv").child<bhv::condition>("c2", [&t] { return t % 3 == 0; }))
+           .add(bhv::repeat("repeat", 2).child<bhv::action>("a2", step(4))))
+      .add(bhv::if_("if", bhv::condition("c3", [&t] { return t % 5 < 2; }))
+           .then_(bhv::retry("retry", 2).child<bhv::action>("a3", step(5)))
+           .else_(bhv::force("force", bhv::status::failure).child<bhv::action>("a4", step(3))))
+      .add(bhv::switch_("switch")
+           .case_<bhv::condition>("k0", [&t] { return t % 3 == 0; })
+           .case_<bhv::condition>("k1", [&t] { return t % 2 == 0; })
+             .handler<bhv::action>("h0", step(3))
+           .case_<bhv::condition>("k2", [&t] { return t % 4 == 1; })
+             .handler<bhv::action>("h1", step(4))
+           .default_<bhv::action>("d", step(5)))
+      .add(bhv::switch_("keyed", [&t] { return t % 5; })
+           .case_(0)
+           .case_(1)
+             .handler<bhv::action>("kh0", step(3))
+           .case_(1)
+           .case_(3)
+             .handler<bhv::action>("kh1", step(2)))
+      .add(bhv::reactive("reactive").child<bhv::condition>("c4", [&t] { return t % 7 < 3; }, in)))
+    .add<bhv::action>("last", step(2));
+  // clang-format on
+}
+
+} // namespace
+
+TEST_CASE("Allocations are counted", "[allocations]") {
+  size_t const before = test::allocations();
+  auto str = std::make_unique<std::string>(100, 'x');
+  REQUIRE(test::allocations() > before);
+
+  struct alignas(64) aligned {
+    char data[64];
+  };
+  auto const count = test::allocations();
+  auto ptr = std::make_unique<aligned>();
+  REQUIRE(reinterpret_cast<std::uintptr_t>(ptr.get()) % 64 == 0);
+  std::unique_ptr<int> nothrow(new (std::nothrow) int(0));
+  REQUIRE(test::allocations() == count + 2);
+}
+
+TEST_CASE("Ticks don't allocate after the warm-up", "[allocations]") {
+  int t = 0;
+  bhv::input in;
+  auto root = make_tree(t, in);
+
+  for (; t < 100; ++t) {
+    root();
+    in.notify();
+  }
+
+  size_t const before = test::allocations();
+
+  for (; t < 1000; ++t) {
+    root();
+    in.notify();
+  }
+
+  REQUIRE(test::allocations() == before);
+
+  root.halt();
+  REQUIRE(test::allocations() == before);
+}
+
+TEST_CASE("Flat and batch ticks don't allocate after the warm-up",
+          "[allocations]") {
+  int t = 0;
+  bhv::input in;
+  auto root = make_tree(t, in);
+
+  bhv::flat_tree const tree(root);
+  auto st = tree.make_state();
+  bhv::batch runner(tree, 8);
+
+  for (; t < 100; ++t) {
+    tree(st);
+    runner();
+  }
+
+  size_t const before = test::allocations();
+
+  for (; t < 1000; ++t) {
+    tree(st);
+    runner();
+  }
+
+  tree.halt(st);
+  REQUIRE(test::allocations() == before);
+}
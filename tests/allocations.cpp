@@ -0,0 +1,72 @@
+#include "allocations.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local size_t counter = 0;
+
+void *allocate(std::size_t size) {
+  ++counter;
+  if (void *ptr = std::malloc(size ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+// The original pointer is stored before the aligned block
+void *allocate(std::size_t size, std::align_val_t align) {
+  auto const alignment = static_cast<std::size_t>(align);
+  void *const ptr = allocate(size + alignment + sizeof(void *));
+  auto const addr = reinterpret_cast<std::uintptr_t>(ptr) + sizeof(void *);
+  auto *const aligned = reinterpret_cast<void **>(
+      (addr + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1));
+  aligned[-1] = ptr;
+  return aligned;
+}
+
+void deallocate(void *ptr) noexcept { std::free(ptr); }
+
+void deallocate(void *ptr, std::align_val_t) noexcept {
+  if (ptr)
+    std::free(static_cast<void **>(ptr)[-1]);
+}
+
+template <typename... Args>
+void *try_allocate(std::size_t size, Args... args) noexcept {
+  try {
+    return allocate(size, args...);
+  } catch (...) {
+    return nullptr;
+  }
+}
+} // namespace
+
+namespace test {
+size_t allocations() { return counter; }
+} // namespace test
+
+// The whole set is replaced, so every allocation is paired with std::free
+using std::align_val_t;
+using std::nothrow_t;
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, nothrow_t const &) noexcept { return try_allocate(size); }
+void *operator new[](std::size_t size, nothrow_t const &) noexcept { return try_allocate(size); }
+void *operator new(std::size_t size, align_val_t al) { return allocate(size, al); }
+void *operator new[](std::size_t size, align_val_t al) { return allocate(size, al); }
+void *operator new(std::size_t size, align_val_t al, nothrow_t const &) noexcept { return try_allocate(size, al); }
+void *operator new[](std::size_t size, align_val_t al, nothrow_t const &) noexcept { return try_allocate(size, al); }
+
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, nothrow_t const &) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr, nothrow_t const &) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, align_val_t al) noexcept { deallocate(ptr, al); }
+void operator delete[](void *ptr, align_val_t al) noexcept { deallocate(ptr, al); }
+void operator delete(void *ptr, std::size_t, align_val_t al) noexcept { deallocate(ptr, al); }
+void operator delete[](void *ptr, std::size_t, align_val_t al) noexcept { deallocate(ptr, al); }
+void operator delete(void *ptr, align_val_t al, nothrow_t const &) noexcept { deallocate(ptr, al); }
+void operator delete[](void *ptr, align_val_t al, nothrow_t const &) noexcept { deallocate(ptr, al); }
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+namespace test {
+
+/**
+ * @brief Number of allocations made by the calling thread through the global
+ * operator new. All the overloads of the operators new and delete are replaced
+ * for the whole test executable.
+ */
+size_t allocations();
+
+} // namespace test
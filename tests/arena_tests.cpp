@@ -0,0 +1,94 @@
+#include "catch.hpp"
+#include "counting_resource.hpp"
+#include <bhvarena.hpp>
+#include <bhvtree.hpp>
+#include <memory_resource>
+
+using namespace cppttl;
+
+TEST_CASE("Nodes are allocated from the thread memory resource", "[arena]") {
+  test::counting_resource resource;
+  int n = 0;
+
+  auto prev = bhv::set_memory_resource(&resource);
+
+  // clang-format off
+  auto seq =
+      bhv::make_node<bhv::sequence>(
+        bhv::sequence("root")
+          .add<bhv::action>("1", [&n] { ++n; return bhv::status::success; })
+          .add(bhv::fallback("fal")
+               .add<bhv::condition>("2", [&n] { ++n; return false; })
+               .add<bhv::action>("3", [&n] { ++n; return bhv::status::success; })));
+  // clang-format on
+
+  REQUIRE(bhv::set_memory_resource(prev) == &resource);
+  REQUIRE(bhv::get_memory_resource() == std::pmr::get_default_resource());
+
+  // 5 nodes and at least 2 child lists
+  REQUIRE(resource.allocations() >= 7);
+  REQUIRE((*seq)() == bhv::status::success);
+  REQUIRE(n == 3);
+
+  size_t const allocations = resource.allocations();
+  auto copy = bhv::sequence(*seq);
+  REQUIRE(resource.allocations() == allocations);
+
+  seq.reset();
+  REQUIRE(resource.deallocations() > 0);
+}
+
+TEST_CASE("Tree built in the arena", "[arena]") {
+  int n = 0;
+
+  bhv::arena arena;
+
+  // clang-format off
+  auto tree = arena.build([&] {
+    return bhv::sequence("root")
+      .add<bhv::action>("1", [&n] { ++n; return bhv::status::success; })
+      .add(bhv::repeat("repeat", 2)
+           .child<bhv::action>("2", [&n] { ++n; return bhv::status::success; }))
+      .add(bhv::if_("if", bhv::condition("cond", [] { return true; }))
+           .then_<bhv::action>("3", [&n] { ++n; return bhv::status::success; }));
+  });
+  // clang-format on
+
+  REQUIRE(bhv::get_memory_resource() == std::pmr::get_default_resource());
+  REQUIRE((*tree)() == bhv::status::success);
+  REQUIRE(n == 4);
+  REQUIRE(tree->childs().get_allocator().resource() == arena.resource());
+}
+
+TEST_CASE("Ticking the arena tree doesn't grow the arena", "[arena]") {
+  int t = 0;
+  bhv::input in;
+
+  bhv::arena arena;
+
+  // clang-format off
+  auto tree = arena.build([&] {
+    return bhv::parallel("root", 4)
+      .add<bhv::action>("1", [&t] { return t % 3 ? bhv::status::running : bhv::status::success; })
+      .add(bhv::switch_("switch")
+           .case_<bhv::condition>("case 0", [&t] { return t % 2 == 0; })
+             .handler<bhv::action>("handler 0", [&t] { return t % 4 ? bhv::status::running : bhv::status::success; })
+           .default_<bhv::action>("default", [] { return bhv::status::success; }))
+      .add(bhv::switch_("keyed", [&t] { return t % 3; })
+           .case_(0)
+           .case_(2)
+             .handler<bhv::action>("handler 1", [] { return bhv::status::success; }))
+      .add(bhv::reactive("reactive").child<bhv::condition>("cond", [&t] { return t % 5 < 2; }, in));
+  });
+  // clang-format on
+
+  size_t const used = arena.used();
+  REQUIRE(used > 0);
+
+  for (; t < 100; ++t) {
+    (*tree)();
+    in.notify();
+  }
+
+  REQUIRE(arena.used() == used);
+}
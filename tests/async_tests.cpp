@@ -0,0 +1,95 @@
+#include "catch.hpp"
+#include <atomic>
+#include <bhvasync.hpp>
+#include <bhvexecutor.hpp>
+#include <bhvtree.hpp>
+#include <thread>
+
+using namespace cppttl;
+
+namespace {
+
+// Tick the node until it completes
+bhv::status poll(bhv::node &node) {
+  bhv::status st;
+  while ((st = node()) == bhv::status::running)
+    std::this_thread::yield();
+  return st;
+}
+
+} // namespace
+
+TEST_CASE("Async action doesn't block the tick", "[async]") {
+  bhv::thread_pool pool(2);
+  std::atomic<bool> go{};
+  std::atomic<int> n{};
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add(bhv::async_action("work", pool, [&] {
+          while (!go)
+            std::this_thread::yield();
+          ++n;
+          return bhv::status::success;
+        }))
+        .add<bhv::action>("next", [&n] { return n == 1 ? bhv::status::success : bhv::status::failure; });
+  // clang-format on
+
+  for (int i = 0; i < 3; ++i)
+    REQUIRE(seq() == bhv::status::running);
+
+  go = true;
+  REQUIRE(poll(seq) == bhv::status::success);
+  REQUIRE(n == 1);
+}
+
+TEST_CASE("Async action rethrows the exception", "[async]") {
+  bhv::thread_pool pool(1);
+  std::atomic<bool> exception{true};
+
+  auto work = bhv::async_action("work", pool, [&] {
+    if (exception.exchange(false))
+      throw 42;
+    return bhv::status::failure;
+  });
+
+  REQUIRE_THROWS(poll(work));
+  REQUIRE(poll(work) == bhv::status::failure);
+}
+
+TEST_CASE("Halted async action cancels the work", "[async]") {
+  bhv::thread_pool pool(1);
+  std::atomic<bool> started{};
+  std::atomic<int> cancelled{};
+  std::atomic<int> completed{};
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add(bhv::async_action("work", pool, [&](bhv::cancellation const &token) {
+          started = true;
+          while (!token.requested()) {
+            if (completed == 0 && cancelled == 1)
+              break;
+            std::this_thread::yield();
+          }
+          if (token.requested())
+            ++cancelled;
+          else
+            ++completed;
+          return bhv::status::success;
+        }));
+  // clang-format on
+
+  REQUIRE(seq() == bhv::status::running);
+  while (!started)
+    std::this_thread::yield();
+
+  seq.halt();
+
+  // The next activation starts once the cancelled work is finished
+  REQUIRE(poll(seq) == bhv::status::success);
+  REQUIRE(cancelled == 1);
+  REQUIRE(completed == 1);
+}
@@ -0,0 +1,168 @@
+#include "catch.hpp"
+#include <bhvbatch.hpp>
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <vector>
+
+using namespace cppttl;
+
+namespace {
+
+// Agent-specific leaf logic shared by the scalar and the batch leaves
+struct world {
+  static constexpr size_t agents_number = 16;
+
+  size_t current = {};
+  std::vector<int> work = std::vector<int>(agents_number);
+  std::vector<int> calls = std::vector<int>(agents_number);
+  int batch_calls = {};
+
+  bool ready(size_t agent) const { return agent % 3 != 0; }
+  bool odd(size_t agent) const { return agent % 2 != 0; }
+
+  bhv::status step(size_t agent) {
+    ++calls[agent];
+    return ++work[agent] % (agent % 4 + 1) ? bhv::status::running
+                                           : bhv::status::success;
+  }
+
+  bhv::status fail(size_t agent) {
+    ++calls[agent];
+    return agent % 5 == 0 ? bhv::status::failure : bhv::status::success;
+  }
+
+  template <typename Fn> bhv::batch::leaf batch(Fn fn) {
+    return [this, fn](bhv::agents const &active, bhv::status *results) {
+      ++batch_calls;
+      for (size_t i = 0; i < active.size(); ++i)
+        results[i] = fn(active[i]);
+    };
+  }
+};
+
+} // namespace
+
+TEST_CASE("Batch matches scalar ticks", "[batch]") {
+  world scalar, batched;
+
+  auto make_tree = [](world &w) {
+    // clang-format off
+    return bhv::parallel("root", 2)
+      .add(bhv::sequence("seq")
+           .add<bhv::condition>("ready", [&w] { return w.ready(w.current); })
+           .add<bhv::action>("step", [&w] { return w.step(w.current); })
+           .add<bhv::action>("fail", [&w] { return w.fail(w.current); }))
+      .add(bhv::if_("if", bhv::condition("odd", [&w] { return w.odd(w.current); }))
+           .then_(bhv::repeat("repeat", 2)
+                  .child<bhv::action>("step", [&w] { return w.step(w.current); }))
+           .else_(bhv::retry("retry", 3)
+                  .child<bhv::action>("fail", [&w] { return w.fail(w.current); })))
+      .add(bhv::switch_("switch")
+           .case_<bhv::condition>("odd", [&w] { return w.odd(w.current); })
+             .handler<bhv::action>("step", [&w] { return w.step(w.current); })
+           .case_<bhv::condition>("ready", [&w] { return w.ready(w.current); })
+             .handler<bhv::action>("fail", [&w] { return w.fail(w.current); })
+           .default_(bhv::invert("inv")
+                     .child<bhv::action>("fail", [&w] { return w.fail(w.current); })));
+    // clang-format on
+  };
+
+  auto scalar_root = make_tree(scalar);
+  auto batch_root = make_tree(batched);
+
+  bhv::flat_tree const scalar_tree(scalar_root);
+  bhv::flat_tree const batch_tree(batch_root);
+
+  std::vector<bhv::flat_tree::state> states(world::agents_number,
+                                            scalar_tree.make_state());
+
+  bhv::batch runner(batch_tree, world::agents_number);
+  runner.bind("ready", batched.batch([&](size_t a) {
+    return batched.ready(a) ? bhv::status::success : bhv::status::failure;
+  }));
+  runner.bind("odd", batched.batch([&](size_t a) {
+    return batched.odd(a) ? bhv::status::success : bhv::status::failure;
+  }));
+  runner.bind("step", batched.batch([&](size_t a) { return batched.step(a); }));
+  runner.bind("fail", batched.batch([&](size_t a) { return batched.fail(a); }));
+
+  for (int frame = 0; frame < 8; ++frame) {
+    auto const &results = runner();
+
+    for (size_t a = 0; a < world::agents_number; ++a) {
+      scalar.current = a;
+      REQUIRE(results[a] == scalar_tree(states[a]));
+    }
+
+    REQUIRE(scalar.work == batched.work);
+    REQUIRE(scalar.calls == batched.calls);
+  }
+
+  REQUIRE(batched.batch_calls > 0);
+}
+
+TEST_CASE("Batch ticks a subset of agents", "[batch]") {
+  std::vector<int> n(4);
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("a", [] { return bhv::status::success; })
+        .add<bhv::action>("b", [] { return bhv::status::success; });
+  // clang-format on
+
+  bhv::flat_tree const tree(seq);
+  bhv::batch runner(tree, n.size());
+
+  runner.bind("b", [&](bhv::agents const &active, bhv::status *results) {
+    for (size_t i = 0; i < active.size(); ++i) {
+      results[i] = ++n[active[i]] < 2 ? bhv::status::running
+                                      : bhv::status::success;
+    }
+  });
+
+  std::vector<size_t> active = {1, 3};
+  std::vector<bhv::status> results(active.size());
+
+  runner(active, results.data());
+  REQUIRE(results == std::vector<bhv::status>{bhv::status::running,
+                                              bhv::status::running});
+  REQUIRE(n == std::vector<int>{0, 1, 0, 1});
+
+  runner(active, results.data());
+  REQUIRE(results == std::vector<bhv::status>{bhv::status::success,
+                                              bhv::status::success});
+  REQUIRE(n == std::vector<int>{0, 2, 0, 2});
+
+  std::vector<size_t> invalid = {4};
+  REQUIRE_THROWS(runner(invalid, results.data()));
+}
+
+TEST_CASE("Batch state is reset after the exception", "[batch]") {
+  int n = 0;
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("a", [&n] { ++n; return bhv::status::success; })
+        .add<bhv::action>("b", [] { return bhv::status::success; });
+  // clang-format on
+
+  bhv::flat_tree const tree(seq);
+  bhv::batch runner(tree, 3);
+
+  bool exception = true;
+  runner.bind("b", [&](bhv::agents const &, bhv::status *) {
+    if (exception)
+      throw 42;
+  });
+
+  REQUIRE_THROWS(runner());
+  REQUIRE(n == 3);
+
+  exception = false;
+  runner.bind("b", bhv::batch::leaf{});
+  auto const &results = runner();
+  REQUIRE(n == 6);
+  REQUIRE(results == std::vector<bhv::status>(3, bhv::status::success));
+}
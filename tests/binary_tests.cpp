@@ -0,0 +1,170 @@
+#include "catch.hpp"
+#include <bhvserializer.hpp>
+#include <bhvtree.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace cppttl;
+
+namespace {
+
+std::string to_text(bhv::node const &ref) {
+  std::stringstream ss;
+  ss << ref;
+  return ss.str();
+}
+
+std::string to_binary(bhv::node const &ref) {
+  std::stringstream ss;
+  bhv::save(ss, ref, bhv::format::binary);
+  return ss.str();
+}
+
+bhv::node::ptr from_binary(std::string const &data, bhv::registry const &reg) {
+  std::stringstream ss(data);
+  return bhv::load(ss, reg, bhv::format::binary);
+}
+
+} // namespace
+
+TEST_CASE("Binary format keeps the tree structure", "[binary]") {
+  int key = 0;
+  auto success = [] { return bhv::status::success; };
+  auto yes = [] { return true; };
+
+  bhv::registry reg;
+  reg.action("a", success).condition("c", yes).key("keyed", [&key] { return key; });
+
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add(bhv::parallel("par", 2)
+             .add<bhv::action>("a", success)
+             .add(bhv::fallback("fal")
+                  .add<bhv::condition>("c", yes)
+                  .add(bhv::invert("inv").child<bhv::action>("a", success))))
+        .add(bhv::if_("if", bhv::condition("c", yes))
+             .then_(bhv::repeat("repeat", 3).child<bhv::action>("a", success))
+             .else_(bhv::retry("retry").child<bhv::action>("a", success)))
+        .add(bhv::switch_("switch")
+             .case_<bhv::condition>("c", yes)
+             .case_<bhv::condition>("c", yes)
+               .handler<bhv::action>("a", success)
+             .case_<bhv::condition>("c", yes)
+               .handler(bhv::force("force", bhv::status::failure))
+             .default_<bhv::action>("a", success))
+        .add(bhv::switch_("keyed", [&key] { return key; })
+             .case_(-5)
+             .case_(1LL << 40)
+               .handler<bhv::action>("a", success)
+             .case_(7)
+               .handler(bhv::reactive("reactive").child<bhv::condition>("c", yes)))
+        .add(bhv::sequence("empty \"quoted\""));
+  // clang-format on
+
+  auto const data = to_binary(root);
+  auto loaded = from_binary(data, reg);
+
+  REQUIRE(loaded);
+  REQUIRE(to_text(*loaded) == to_text(root));
+  REQUIRE(to_binary(*loaded) == data);
+
+  // The names are stored once
+  REQUIRE(data.size() < to_text(root).size() / 2);
+}
+
+TEST_CASE("Loaded leaves are bound to the registry", "[binary]") {
+  int n = 0, halted = 0;
+  bhv::value<int> key(0);
+  bool ready = false;
+
+  bhv::registry reg;
+  // clang-format off
+  reg.action("step", [&n] { return ++n < 2 ? bhv::status::running : bhv::status::success; },
+                     [&halted] { ++halted; })
+     .condition("ready", [&ready] { return ready; }, key)
+     .key("dispatch", [&key] { return key.get(); });
+
+  auto root =
+      bhv::reactive("reactive")
+        .child(bhv::switch_("dispatch", [&key] { return key.get(); })
+               .case_(0)
+                 .handler<bhv::condition>("ready", [] { return false; })
+               .case_(1)
+                 .handler<bhv::action>("step", [] { return bhv::status::failure; }));
+  // clang-format on
+
+  std::stringstream ss;
+  bhv::save(ss, root, bhv::format::binary);
+  auto loaded = bhv::load(ss, reg, bhv::format::binary);
+
+  REQUIRE((*loaded)() == bhv::status::failure);
+
+  // The loaded condition declares the registered inputs
+  ready = true;
+  REQUIRE((*loaded)() == bhv::status::failure);
+  key.set(0);
+  REQUIRE((*loaded)() == bhv::status::failure);
+  key.notify();
+  REQUIRE((*loaded)() == bhv::status::success);
+
+  key.set(1);
+  REQUIRE((*loaded)() == bhv::status::running);
+  loaded->halt();
+  REQUIRE(halted == 1);
+  REQUIRE((*loaded)() == bhv::status::success);
+  REQUIRE(n == 2);
+}
+
+TEST_CASE("Invalid binary data is rejected", "[binary]") {
+  auto success = [] { return bhv::status::success; };
+
+  bhv::registry reg;
+  reg.action("a", success);
+
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add<bhv::action>("a", success)
+        .add<bhv::action>("b", success);
+  // clang-format on
+
+  auto const data = to_binary(root);
+
+  REQUIRE_THROWS(from_binary(data, reg));
+  reg.action("b", success);
+  REQUIRE(from_binary(data, reg));
+
+  for (size_t size = 0; size < data.size(); ++size)
+    REQUIRE_THROWS(from_binary(data.substr(0, size), reg));
+
+  REQUIRE_THROWS(from_binary("BHVX" + data.substr(4), reg));
+  REQUIRE_THROWS(from_binary(to_binary(bhv::switch_("s", [] { return 0; })
+                                           .case_(1)
+                                           .handler<bhv::action>("a", success)),
+                             reg));
+}
+
+TEST_CASE("Deeply nested binary data is rejected", "[binary]") {
+  bhv::registry reg;
+
+  // The invert node without a child is stored as its tag, the name index and
+  // the missing child tag
+  auto const data = to_binary(bhv::invert("i"));
+  auto const header = data.substr(0, data.size() - 3);
+  auto const invert = data.substr(data.size() - 3, 2);
+
+  auto chain = [&](size_t depth) {
+    std::string result = header;
+    for (size_t i = 0; i < depth; ++i)
+      result += invert;
+    return result + data.back();
+  };
+
+  REQUIRE(from_binary(chain(bhv::max_load_depth), reg));
+  REQUIRE(bhv::load(chain(bhv::max_load_depth), reg));
+  REQUIRE_THROWS_AS(from_binary(chain(bhv::max_load_depth + 1), reg),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(bhv::load(chain(1000000), reg), std::runtime_error);
+}
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+#include <bhvtree.hpp>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace cppttl;
+
+namespace {
+
+auto counter(int &n, bhv::status st = bhv::status::success) {
+  return [&n, st] {
+    ++n;
+    return st;
+  };
+}
+
+} // namespace
+
+TEST_CASE("Tick budget bounds the endless repeat", "[budget]") {
+  int n = 0;
+  auto root = bhv::repeat("repeat").child<bhv::action>("a", counter(n));
+
+  bhv::tick_budget budget(10);
+  REQUIRE(root(budget) == bhv::status::running);
+  REQUIRE(n == 11);
+  REQUIRE(budget.exhausted());
+
+  // The exhausted budget still lets the first child tick
+  REQUIRE(root(budget) == bhv::status::running);
+  REQUIRE(n == 12);
+}
+
+TEST_CASE("Tick budget resumes the nodes from the saved position",
+          "[budget]") {
+  int a = 0, b = 0, c = 0;
+  // clang-format off
+  auto root =
+      bhv::sequence("seq")
+        .add<bhv::action>("a", counter(a))
+        .add(bhv::retry("retry", 3).child<bhv::action>("b", counter(b, bhv::status::failure)))
+        .add<bhv::action>("c", counter(c));
+  // clang-format on
+
+  // Every tick proceeds to the next child or attempt once
+  bhv::tick_budget first(1);
+  REQUIRE(root(first) == bhv::status::running);
+  REQUIRE((a == 1 && b == 1 && c == 0));
+
+  // The exhausted budget lets every node tick its current child only
+  bhv::tick_budget none(0);
+  REQUIRE(root(none) == bhv::status::running);
+  REQUIRE((a == 1 && b == 2 && c == 0));
+
+  // The retry fails after the third attempt
+  REQUIRE(root(none) == bhv::status::failure);
+  REQUIRE((a == 1 && b == 3 && c == 0));
+
+  // Without the budget the tree behaves as usual
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE((a == 2 && b == 6 && c == 0));
+}
+
+TEST_CASE("Tick budget in the parallel and switch nodes", "[budget]") {
+  std::vector<int> n(4);
+
+  auto par = bhv::parallel("par", 4);
+  for (auto &i : n)
+    par.add<bhv::action>("a", counter(i));
+
+  bhv::tick_budget budget(0);
+  REQUIRE(par(budget) == bhv::status::running);
+  REQUIRE(n == std::vector<int>{1, 0, 0, 0});
+  REQUIRE(par(budget) == bhv::status::running);
+  REQUIRE(par(budget) == bhv::status::running);
+  REQUIRE(par(budget) == bhv::status::success);
+  REQUIRE(n == std::vector<int>{1, 1, 1, 1});
+
+  int h0 = 0, h1 = 0, d = 0;
+  // clang-format off
+  auto sw =
+      bhv::switch_("switch")
+        .case_<bhv::condition>("c0", [] { return true; })
+          .handler<bhv::action>("h0", counter(h0))
+        .case_<bhv::condition>("c1", [] { return true; })
+          .handler<bhv::action>("h1", counter(h1))
+        .default_<bhv::action>("d", counter(d));
+  // clang-format on
+
+  REQUIRE(sw(budget) == bhv::status::running); // c0
+  REQUIRE(sw(budget) == bhv::status::running); // c1
+  REQUIRE(sw(budget) == bhv::status::running); // h0
+  REQUIRE((h0 == 1 && h1 == 0));
+  REQUIRE(sw(budget) == bhv::status::success); // h1
+  REQUIRE((h0 == 1 && h1 == 1 && d == 0));
+
+  bhv::tick_budget unlimited(bhv::tick_budget::unlimited);
+  REQUIRE(sw(unlimited) == bhv::status::success);
+  REQUIRE((h0 == 2 && h1 == 2 && !unlimited.exhausted()));
+}
+
+TEST_CASE("Tick budget deadline", "[budget]") {
+  using namespace std::chrono;
+
+  int n = 0;
+  auto root = bhv::repeat("repeat").child<bhv::action>("a", [&n] {
+    ++n;
+    std::this_thread::sleep_for(microseconds(100));
+    return bhv::status::success;
+  });
+
+  bhv::tick_budget budget(milliseconds(5));
+  REQUIRE(root(budget) == bhv::status::running);
+  REQUIRE(n > 1);
+  REQUIRE(budget.exhausted());
+
+  bhv::tick_budget expired(steady_clock::now());
+  REQUIRE(root(expired) == bhv::status::running);
+  REQUIRE(expired.exhausted());
+}
@@ -0,0 +1,118 @@
+#include "catch.hpp"
+#include <atomic>
+#include <bhvexecutor.hpp>
+#include <bhvtree.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace cppttl;
+
+namespace {
+
+// Wait until all the children are started, it's only possible if the children
+// are ticked concurrently
+bhv::status rendezvous(std::atomic<int> &started, int n) {
+  ++started;
+  auto const deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (started < n) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return bhv::status::failure;
+    std::this_thread::yield();
+  }
+  return bhv::status::success;
+}
+
+} // namespace
+
+TEST_CASE("Thread pool executes submitted tasks", "[thread_pool]") {
+  std::atomic<int> n{};
+
+  {
+    bhv::thread_pool pool(3);
+    REQUIRE(pool.size() == 3);
+    for (int i = 0; i < 100; ++i)
+      pool.submit([&n] { ++n; });
+  }
+
+  REQUIRE(n == 100);
+}
+
+TEST_CASE("Parallel node ticks children concurrently", "[parallel]") {
+  bhv::thread_pool pool(3);
+  std::atomic<int> started{};
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 4, pool)
+        .add<bhv::action>("1", [&] { return rendezvous(started, 4); })
+        .add<bhv::action>("2", [&] { return rendezvous(started, 4); })
+        .add<bhv::action>("3", [&] { return rendezvous(started, 4); })
+        .add<bhv::action>("4", [&] { return rendezvous(started, 4); });
+  // clang-format on
+
+  REQUIRE(par() == bhv::status::success);
+  REQUIRE(started == 4);
+}
+
+TEST_CASE("Running concurrent parallel node", "[parallel]") {
+  bhv::thread_pool pool(2);
+  std::atomic<int> n1{}, n2{}, n3{};
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 2, pool)
+        .add<bhv::action>("1", [&] { return ++n1 < 2 ? bhv::status::running : bhv::status::success; })
+        .add<bhv::action>("2", [&] { return ++n2 < 3 ? bhv::status::running : bhv::status::success; })
+        .add<bhv::action>("3", [&] { ++n3; return bhv::status::failure; });
+  // clang-format on
+
+  REQUIRE(par() == bhv::status::running);
+  REQUIRE((n1 == 1 && n2 == 1 && n3 == 1));
+  REQUIRE(par() == bhv::status::running);
+  REQUIRE((n1 == 2 && n2 == 2 && n3 == 1));
+  REQUIRE(par() == bhv::status::success);
+  REQUIRE((n1 == 2 && n2 == 3 && n3 == 1));
+}
+
+TEST_CASE("Concurrent parallel node after the exception", "[parallel]") {
+  bhv::thread_pool pool(2);
+  std::atomic<int> n{};
+  std::atomic<bool> exception{true};
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 3, pool)
+        .add<bhv::action>("1", [&] { ++n; return bhv::status::success; })
+        .add<bhv::action>("2", [&] {
+          if (exception.exchange(false))
+            throw 42;
+          return bhv::status::success;
+        })
+        .add<bhv::action>("3", [&] { ++n; return bhv::status::success; });
+  // clang-format on
+
+  REQUIRE_THROWS(par());
+  REQUIRE(par() == bhv::status::success);
+}
+
+TEST_CASE("Nested concurrent parallel nodes", "[parallel]") {
+  bhv::thread_pool pool(1);
+  std::atomic<int> n{};
+
+  auto make = [&](std::string_view name) {
+    // clang-format off
+    return bhv::parallel(name, 2, pool)
+      .add<bhv::action>("1", [&] { ++n; return bhv::status::success; })
+      .add<bhv::action>("2", [&] { ++n; return bhv::status::success; });
+    // clang-format on
+  };
+
+  auto par = bhv::parallel("root", 3, pool)
+                 .add(make("a"))
+                 .add(make("b"))
+                 .add(make("c"));
+
+  REQUIRE(par() == bhv::status::success);
+  REQUIRE(n == 6);
+}
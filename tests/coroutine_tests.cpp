@@ -0,0 +1,127 @@
+#include "catch.hpp"
+#include "counting_resource.hpp"
+#include <bhvcoroutine.hpp>
+
+#ifdef BHVT_COROUTINES
+#include <stdexcept>
+#include <utility>
+
+using namespace cppttl;
+
+TEST_CASE("Coroutine action spans ticks", "[coroutine]") {
+  int steps = 0, n = 0;
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("1", [&n] { ++n; return bhv::status::success; })
+        .add(bhv::coroutine_action("walk", [&]() -> bhv::task {
+          for (int i = 0; i < 3; ++i) {
+            ++steps;
+            co_yield bhv::status::running;
+          }
+          co_return bhv::status::success;
+        }));
+  // clang-format on
+
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE((n == 1 && steps == 1));
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE((n == 1 && steps == 3));
+  REQUIRE(seq() == bhv::status::success);
+
+  // The next activation starts a new coroutine
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE((n == 2 && steps == 4));
+}
+
+TEST_CASE("Coroutine action after the exception", "[coroutine]") {
+  int steps = 0;
+  bool exception = true;
+
+  auto walk = bhv::coroutine_action("walk", [&]() -> bhv::task {
+    ++steps;
+    co_yield bhv::status::running;
+    if (std::exchange(exception, false))
+      throw 42;
+    co_return bhv::status::failure;
+  });
+
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE_THROWS(walk());
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE(steps == 2);
+  REQUIRE(walk() == bhv::status::failure);
+}
+
+TEST_CASE("Coroutine action yields the running status only", "[coroutine]") {
+  int steps = 0;
+
+  auto walk = bhv::coroutine_action("walk", [&]() -> bhv::task {
+    ++steps;
+    co_yield bhv::status::running;
+    co_yield bhv::status::success;
+    ++steps;
+    co_return bhv::status::success;
+  });
+
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE_THROWS_AS(walk(), std::runtime_error);
+  REQUIRE(steps == 1);
+
+  // The failed coroutine is destroyed, the next tick starts a new one
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE(steps == 2);
+}
+
+TEST_CASE("Halted coroutine action releases the frame", "[coroutine]") {
+  int alive = 0;
+
+  struct guard {
+    int &ref;
+    explicit guard(int &r) : ref(r) { ++ref; }
+    ~guard() { --ref; }
+  };
+
+  auto walk = bhv::coroutine_action("walk", [&]() -> bhv::task {
+    guard g(alive);
+    for (;;)
+      co_yield bhv::status::running;
+  });
+
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE(alive == 1);
+  walk.halt();
+  REQUIRE(alive == 0);
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE(alive == 1);
+  walk.halt();
+  REQUIRE(alive == 0);
+}
+
+TEST_CASE("Coroutine frames are reused", "[coroutine]") {
+  test::counting_resource resource;
+  auto prev = bhv::set_memory_resource(&resource);
+
+  bhv::coroutine walk([]() -> bhv::task {
+    co_yield bhv::status::running;
+    co_return bhv::status::success;
+  });
+
+  bhv::set_memory_resource(prev);
+
+  REQUIRE(walk() == bhv::status::running);
+  REQUIRE(walk() == bhv::status::success);
+
+  size_t const allocations = resource.allocations();
+
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(walk() == bhv::status::running);
+    REQUIRE(walk() == bhv::status::success);
+  }
+
+  REQUIRE(resource.allocations() == allocations);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+namespace test {
+
+/**
+ * @brief Memory resource counting the allocations and the allocated bytes.
+ * The memory is allocated from the new/delete resource. The resource is shared
+ * by the tests and the benchmarks.
+ */
+class counting_resource final : public std::pmr::memory_resource {
+public:
+  size_t allocations() const { return _allocations.load(); }
+  size_t deallocations() const { return _deallocations.load(); }
+
+  /**
+   * @brief Number of the allocated bytes
+   */
+  size_t allocated() const { return _allocated.load(); }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    ++_allocations;
+    _allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    ++_deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+
+  std::atomic<size_t> _allocations{};
+  std::atomic<size_t> _deallocations{};
+  std::atomic<size_t> _allocated{};
+};
+
+} // namespace test
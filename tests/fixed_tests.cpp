@@ -0,0 +1,135 @@
+#include "catch.hpp"
+#include <bhvfixed.hpp>
+#include <type_traits>
+
+using namespace cppttl;
+namespace fixed = bhv::fixed;
+
+TEST_CASE("Fixed sequence of sequences", "[fixed]") {
+  int n = 0;
+
+  // clang-format off
+  auto seq =
+      fixed::sequence("root",
+        fixed::sequence("seq0",
+          fixed::action("1", [&n] { ++n; return bhv::status::success; }),
+          fixed::action("2", [&n] { ++n; return bhv::status::success; })),
+        fixed::sequence("seq1",
+          fixed::action("3", [&n] { ++n; return bhv::status::success; }),
+          fixed::action("4", [&n] { ++n; return bhv::status::success; })));
+  // clang-format on
+
+  static_assert(!std::is_polymorphic_v<decltype(seq)>);
+
+  REQUIRE(seq() == bhv::status::success);
+  REQUIRE(n == 4);
+  REQUIRE(seq.name() == "root");
+}
+
+TEST_CASE("Running fixed sequence node", "[fixed]") {
+  int n = 0;
+
+  // clang-format off
+  auto seq =
+      fixed::sequence("root",
+        fixed::action("1", [&n] { return ++n < 2 ? bhv::status::running : bhv::status::success; }),
+        fixed::action("2", [&n] { return ++n < 4 ? bhv::status::running : bhv::status::success; }),
+        fixed::action("3", [&n] { return ++n < 6 ? bhv::status::running : bhv::status::success; }));
+  // clang-format on
+
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(seq() == bhv::status::running);
+    REQUIRE(n == 1 + i * 2);
+  }
+
+  REQUIRE(seq() == bhv::status::success);
+  REQUIRE(n == 6);
+}
+
+TEST_CASE("Fixed fallback after the exception", "[fixed]") {
+  int n = 0;
+
+  // clang-format off
+  auto fal =
+      fixed::fallback("root",
+        fixed::condition("1", [&n] { ++n; return false; }),
+        fixed::action("2", [&n] {
+          if (++n < 3)
+            throw 42;
+          return bhv::status::failure;
+        }),
+        fixed::action("3", [&n] { ++n; return bhv::status::success; }));
+  // clang-format on
+
+  REQUIRE_THROWS(fal());
+  REQUIRE(n == 2);
+  REQUIRE(fal() == bhv::status::success);
+  REQUIRE(n == 5);
+}
+
+TEST_CASE("Running fixed parallel node", "[fixed]") {
+  int n = 0;
+
+  // clang-format off
+  auto par =
+      fixed::parallel("root", 2,
+        fixed::action("1", [&n] { n = 1; return bhv::status::failure; }),
+        fixed::action("2", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::success; }),
+        fixed::action("3", [&n] { return ++n < 4 ? bhv::status::running : bhv::status::success; }),
+        fixed::action("4", [&n] { return ++n < 5 ? bhv::status::running : bhv::status::success; }));
+  // clang-format on
+
+  REQUIRE(par() == bhv::status::running);
+  REQUIRE(n == 4);
+  REQUIRE(par() == bhv::status::success);
+  REQUIRE(n == 6); // The last child isn't ticked once the outcome is decided
+  REQUIRE(par() == bhv::status::running);
+  REQUIRE(n == 4);
+}
+
+TEST_CASE("Fixed if/then/else", "[fixed]") {
+  int n = 0;
+  bool cond = true;
+
+  // clang-format off
+  auto if_ =
+      fixed::if_("if", fixed::condition("cond", [&] { return cond; }),
+        fixed::action("then", [&] { return ++n < 2 ? bhv::status::running : bhv::status::success; }),
+        fixed::action("else", [&] { n = 42; return bhv::status::failure; }));
+  auto if_then =
+      fixed::if_("if", fixed::condition("cond", [&] { return cond; }),
+        fixed::action("then", [&] { return bhv::status::success; }));
+  // clang-format on
+
+  REQUIRE((if_() == bhv::status::running && n == 1));
+  cond = false;
+  REQUIRE((if_() == bhv::status::success && n == 2));
+  REQUIRE((if_() == bhv::status::failure && n == 42));
+  REQUIRE(if_then() == bhv::status::failure);
+  cond = true;
+  REQUIRE(if_then() == bhv::status::success);
+}
+
+TEST_CASE("Fixed decorators", "[fixed]") {
+  int n = 0;
+
+  // clang-format off
+  auto tree =
+      fixed::sequence("root",
+        fixed::repeat("repeat", 3,
+          fixed::action("a", [&] { ++n; return bhv::status::success; })),
+        fixed::retry("retry", 3,
+          fixed::action("b", [&] { return ++n < 5 ? bhv::status::failure : bhv::status::success; })),
+        fixed::force("force", bhv::status::success,
+          fixed::invert("invert",
+            fixed::condition("c", [] { return true; }))));
+  // clang-format on
+
+  REQUIRE(tree() == bhv::status::success);
+  REQUIRE(n == 5);
+
+  auto retry = fixed::retry("retry", 2,
+      fixed::action("a", [&] { ++n; return bhv::status::failure; }));
+  REQUIRE(retry() == bhv::status::failure);
+  REQUIRE(n == 7);
+}
@@ -0,0 +1,276 @@
+#include "catch.hpp"
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <string>
+#include <vector>
+
+using namespace cppttl;
+
+TEST_CASE("Flat tree layout", "[flat]") {
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add(bhv::fallback("fal")
+             .add<bhv::condition>("c", [] { return false; })
+             .add<bhv::action>("a", [] { return bhv::status::success; }))
+        .add(bhv::invert("inv")
+             .child<bhv::condition>("c", [] { return false; }));
+  // clang-format on
+
+  bhv::flat_tree tree(seq);
+  auto st = tree.make_state();
+  auto const &records = tree.records();
+  auto const &links = tree.links();
+
+  REQUIRE(records.size() == 6);
+  REQUIRE(records[0].type == bhv::node_type::sequence);
+  REQUIRE(records[1].type == bhv::node_type::fallback);
+  REQUIRE(records[2].type == bhv::node_type::condition);
+  REQUIRE(records[3].type == bhv::node_type::action);
+  REQUIRE(records[4].type == bhv::node_type::invert);
+  REQUIRE(records[5].type == bhv::node_type::condition);
+
+  REQUIRE(records[0].count == 2);
+  REQUIRE(links[records[0].first] == 1);
+  REQUIRE(links[records[0].first + 1] == 4);
+  REQUIRE(links[records[1].first] == 2);
+  REQUIRE(links[records[1].first + 1] == 3);
+  REQUIRE(links[records[4].first] == 5);
+  REQUIRE(records[0].source == &seq);
+
+  REQUIRE(tree(st) == bhv::status::success);
+}
+
+TEST_CASE("Running flat sequence", "[flat]") {
+  int n = 0;
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("1", [&n] { return ++n < 2 ? bhv::status::running : bhv::status::success; })
+        .add<bhv::action>("2", [&n] { return ++n < 4 ? bhv::status::running : bhv::status::success; })
+        .add<bhv::action>("3", [&n] { return ++n < 6 ? bhv::status::running : bhv::status::success; });
+  // clang-format on
+
+  bhv::flat_tree tree(seq);
+  auto st = tree.make_state();
+
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(tree(st) == bhv::status::running);
+    REQUIRE(n == 1 + i * 2);
+  }
+
+  REQUIRE(tree(st) == bhv::status::success);
+  REQUIRE(n == 6);
+}
+
+TEST_CASE("Running flat parallel", "[flat]") {
+  int n = 0;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 2)
+        .add<bhv::action>("1", [&n] { n = 1; return bhv::status::failure; })
+        .add<bhv::action>("2", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::failure; })
+        .add<bhv::action>("3", [&n] { return ++n < 4 ? bhv::status::running : bhv::status::success; })
+        .add<bhv::action>("4", [&n] { return ++n < 5 ? bhv::status::running : bhv::status::failure; });
+  // clang-format on
+
+  bhv::flat_tree tree(par);
+  auto st = tree.make_state();
+
+  REQUIRE(tree(st) == bhv::status::running);
+  REQUIRE(n == 4);
+  REQUIRE(tree(st) == bhv::status::failure);
+  REQUIRE(n == 7);
+  REQUIRE(tree(st) == bhv::status::running);
+  REQUIRE(n == 4);
+}
+
+TEST_CASE("Flat if/then/else", "[flat]") {
+  int n = 0;
+  bool cond = true;
+
+  // clang-format off
+  auto if_ =
+      bhv::if_("if", bhv::condition("cond", [&] { return cond; }))
+        .then_<bhv::action>("then", [&] { return ++n < 2 ? bhv::status::running : bhv::status::success; })
+        .else_<bhv::action>("else", [&] { n = 42; return bhv::status::failure; });
+  // clang-format on
+
+  bhv::flat_tree tree(if_);
+  auto st = tree.make_state();
+
+  REQUIRE((tree(st) == bhv::status::running && n == 1));
+  cond = false;
+  REQUIRE((tree(st) == bhv::status::success && n == 2));
+  REQUIRE((tree(st) == bhv::status::failure && n == 42));
+}
+
+TEST_CASE("Flat switch with running cases and handlers", "[flat]") {
+  int n, h = 0, c0 = 0, h0 = 0, h1 = 0;
+
+  // clang-format off
+  auto switch_ =
+    bhv::switch_("switch")
+      .case_<bhv::action>("case 0", [&] {
+        if (n != 0)
+          return bhv::status::failure;
+        return ++c0 < 2 ? bhv::status::running : bhv::status::success;
+      })
+        .handler<bhv::action>("handler 0", [&] { return ++h0 < 2 ? bhv::status::running : bhv::status::success; })
+      .case_<bhv::condition>("case 1", [&] { return n == 1; })
+      .case_<bhv::condition>("case 2", [&] { return n >= 1; })
+        .handler<bhv::action>("handler 1", [&] { ++h1; return bhv::status::failure; })
+      .default_<bhv::action>("default", [&] { ++h; return bhv::status::success; });
+  // clang-format on
+
+  bhv::flat_tree tree(switch_);
+  auto st = tree.make_state();
+
+  n = 0;
+  REQUIRE((tree(st) == bhv::status::running && c0 == 1 && h0 == 0));
+  REQUIRE((tree(st) == bhv::status::running && c0 == 2 && h0 == 1));
+  REQUIRE((tree(st) == bhv::status::success && c0 == 2 && h0 == 2));
+
+  n = 1;
+  REQUIRE((tree(st) == bhv::status::failure && h1 == 1));
+
+  n = -1;
+  REQUIRE((tree(st) == bhv::status::success && h == 1));
+}
+
+TEST_CASE("Flat repeat after the exception", "[flat]") {
+  int n = 0;
+  bool exception = true;
+
+  // clang-format off
+  auto repeat =
+        bhv::repeat("repeat", 3)
+        .child<bhv::action>("a", [&] {
+          if (++n < 3)
+            return bhv::status::running;
+          if (exception) {
+            exception = false;
+            throw 42;
+          }
+          return bhv::status::success;
+        });
+  // clang-format on
+
+  bhv::flat_tree tree(repeat);
+  auto st = tree.make_state();
+
+  REQUIRE((tree(st) == bhv::status::running && n == 1));
+  REQUIRE((tree(st) == bhv::status::running && n == 2));
+  REQUIRE_THROWS(tree(st));
+  REQUIRE((tree(st) == bhv::status::success && n == 6));
+}
+
+TEST_CASE("Flat decorator without child", "[flat]") {
+  auto retry = bhv::retry("retry", 3);
+  bhv::flat_tree tree(retry);
+  auto st = tree.make_state();
+  REQUIRE_THROWS(tree(st));
+}
+
+TEST_CASE("Flat tree shared by many instances", "[flat]") {
+  int n = 0;
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("1", [&n] { ++n; return bhv::status::success; })
+        .add<bhv::action>("2", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::success; });
+  // clang-format on
+
+  bhv::flat_tree const tree(seq);
+  auto st0 = tree.make_state();
+  auto st1 = tree.make_state();
+
+  REQUIRE(st0.size() == tree.state_size());
+  REQUIRE((tree(st0) == bhv::status::running && n == 2));
+  REQUIRE((tree(st1) == bhv::status::success && n == 4));
+  REQUIRE((tree(st0) == bhv::status::success && n == 5));
+
+  bhv::flat_tree::state invalid;
+  REQUIRE_THROWS(tree(invalid));
+}
+
+TEST_CASE("Flat tree resumes the active path", "[flat]") {
+  struct script {
+    std::vector<std::string> log;
+    int tick = 0;
+
+    // Leaf status depends on the leaf and the tick number
+    bhv::status leaf(std::string const &name, int period) {
+      log.push_back(name);
+      if (name == "throw" && tick % 7 == 3)
+        throw 42;
+      int const phase = (tick + int(name.size())) % period;
+      return phase == 0   ? bhv::status::success
+             : phase == 1 ? bhv::status::failure
+                          : bhv::status::running;
+    }
+  };
+
+  auto make_tree = [](script &s) {
+    auto leaf = [&s](char const *name, int period) {
+      return bhv::action(name, [&s, name, period] { return s.leaf(name, period); });
+    };
+    // clang-format off
+    return bhv::sequence("root")
+      .add(bhv::fallback("fal")
+           .add(bhv::invert("inv")
+                .child(bhv::repeat("repeat", 2)
+                       .child(bhv::if_("if", leaf("cond", 3))
+                              .then_(bhv::sequence("seq")
+                                     .add(leaf("a", 4))
+                                     .add(leaf("throw", 5)))
+                              .else_(bhv::retry("retry", 3)
+                                     .child(leaf("b", 3))))))
+           .add(bhv::force("force", bhv::status::success)
+                .child(bhv::parallel("par", 1)
+                       .add(leaf("c", 4))
+                       .add(leaf("dd", 5)))))
+      .add(leaf("last", 3));
+    // clang-format on
+  };
+
+  script dynamic_script, flat_script;
+  auto dynamic_tree = make_tree(dynamic_script);
+  auto flat_root = make_tree(flat_script);
+  bhv::flat_tree const tree(flat_root);
+  auto st = tree.make_state();
+
+  size_t resumed = 0;
+
+  for (int i = 0; i < 200; ++i) {
+    dynamic_script.tick = flat_script.tick = i;
+
+    bool dynamic_exception = false, flat_exception = false;
+    bhv::status dynamic_status{}, flat_status{};
+
+    if (st[tree.nodes_state_size()] > 1)
+      ++resumed;
+
+    try {
+      dynamic_status = dynamic_tree();
+    } catch (int) {
+      dynamic_exception = true;
+    }
+
+    try {
+      flat_status = tree(st);
+    } catch (int) {
+      flat_exception = true;
+    }
+
+    REQUIRE(dynamic_exception == flat_exception);
+    if (!dynamic_exception)
+      REQUIRE(dynamic_status == flat_status);
+    REQUIRE(dynamic_script.log == flat_script.log);
+  }
+
+  REQUIRE(resumed > 0);
+}
@@ -0,0 +1,276 @@
+#include "catch.hpp"
+#include <algorithm>
+#include <bhvbatch.hpp>
+#include <bhvfixed.hpp>
+#include <bhvflat.hpp>
+#include <bhvtree.hpp>
+#include <vector>
+
+using namespace cppttl;
+
+TEST_CASE("Halting a running sequence", "[halt]") {
+  int n = 0, halted = 0;
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::action>("1", [&n] { ++n; return bhv::status::success; })
+        .add<bhv::action>("2", [] { return bhv::status::running; }, [&halted] { ++halted; })
+        .add<bhv::action>("3", [] { return bhv::status::success; }, [&halted] { halted += 10; });
+  // clang-format on
+
+  seq.halt();
+  REQUIRE(halted == 0);
+
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE(n == 1);
+
+  seq.halt();
+  REQUIRE(halted == 1);
+
+  // The halted sequence starts from the first child
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE(n == 2);
+
+  // The action is halted only once
+  seq.halt();
+  seq.halt();
+  REQUIRE(halted == 2);
+}
+
+TEST_CASE("Parallel halts running children once the outcome is decided",
+          "[halt]") {
+  int n = 0, halted = 0;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 1)
+        .add<bhv::action>("1", [&n] { return ++n < 2 ? bhv::status::running : bhv::status::success; })
+        .add(bhv::sequence("seq")
+             .add(bhv::repeat("repeat")
+                  .child<bhv::action>("2", [] { return bhv::status::running; }, [&halted] { ++halted; })));
+  // clang-format on
+
+  REQUIRE(par() == bhv::status::running);
+  REQUIRE(halted == 0);
+  REQUIRE(par() == bhv::status::success);
+  REQUIRE(halted == 1);
+}
+
+TEST_CASE("Switch halts running handlers after the exception", "[halt]") {
+  int halted = 0;
+  bool exception = false;
+
+  // clang-format off
+  auto switch_ =
+    bhv::switch_("switch")
+      .case_<bhv::condition>("case 0", [] { return true; })
+        .handler<bhv::action>("handler 0", [] { return bhv::status::running; }, [&halted] { ++halted; })
+      .case_<bhv::condition>("case 1", [] { return true; })
+        .handler<bhv::action>("handler 1", [&] {
+          if (exception)
+            throw 42;
+          return bhv::status::running;
+        });
+  // clang-format on
+
+  REQUIRE(switch_() == bhv::status::running);
+  exception = true;
+  REQUIRE_THROWS(switch_());
+  REQUIRE(halted == 1);
+}
+
+TEST_CASE("Halting a flat tree instance", "[halt]") {
+  int halted = 0;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 2)
+        .add<bhv::action>("1", [] { return bhv::status::running; }, [&halted] { ++halted; })
+        .add(bhv::if_("if", bhv::condition("cond", [] { return true; }))
+             .then_<bhv::action>("2", [] { return bhv::status::running; }, [&halted] { halted += 10; }));
+  // clang-format on
+
+  bhv::flat_tree const tree(par);
+  auto st0 = tree.make_state();
+  auto st1 = tree.make_state();
+
+  REQUIRE(tree(st0) == bhv::status::running);
+
+  // The idle instance has nothing to halt
+  tree.halt(st1);
+  REQUIRE(halted == 0);
+
+  tree.halt(st0);
+  REQUIRE(halted == 11);
+  REQUIRE(st0 == tree.make_state());
+
+  bhv::flat_tree::state invalid;
+  REQUIRE_THROWS(tree.halt(invalid));
+}
+
+TEST_CASE("Halting a fixed tree", "[halt]") {
+  int n = 0, halted = 0;
+
+  auto tree = bhv::fixed::parallel(
+      "root", 1,
+      bhv::fixed::action("1",
+                         [&n] {
+                           return ++n < 2 ? bhv::status::running
+                                          : bhv::status::success;
+                         }),
+      bhv::fixed::invert(
+          "invert", bhv::fixed::action(
+                        "2", [] { return bhv::status::running; },
+                        [&halted] { ++halted; })));
+
+  REQUIRE(tree() == bhv::status::running);
+  REQUIRE(tree() == bhv::status::success);
+  REQUIRE(halted == 1);
+
+  n = 0;
+  REQUIRE(tree() == bhv::status::running);
+  tree.halt();
+  REQUIRE(halted == 2);
+  tree.halt();
+  REQUIRE(halted == 2);
+}
+
+TEST_CASE("Batch parallel halts running children once the outcome is decided",
+          "[halt]") {
+  int n = 0, halted = 0;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 1)
+        .add<bhv::action>("1", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::success; })
+        .add(bhv::sequence("seq")
+             .add(bhv::repeat("repeat")
+                  .child<bhv::action>("2", [] { return bhv::status::running; }, [&halted] { ++halted; })));
+  // clang-format on
+
+  bhv::flat_tree const tree(par);
+  bhv::batch runner(tree, 2);
+
+  REQUIRE(runner()[0] == bhv::status::running);
+  REQUIRE(halted == 0);
+
+  // The first agent completes the action "1" on the third call
+  std::vector<size_t> const first = {0};
+  bhv::status result;
+  runner(bhv::agents(first), &result);
+  REQUIRE(result == bhv::status::success);
+  REQUIRE(halted == 1);
+
+  // The second agent is still running
+  runner.halt();
+  REQUIRE(halted == 2);
+  runner.halt();
+  REQUIRE(halted == 2);
+}
+
+TEST_CASE("Batch switch halts running handlers after the exception",
+          "[halt]") {
+  int halted = 0;
+  bool exception = false;
+
+  // clang-format off
+  auto switch_ =
+    bhv::switch_("switch")
+      .case_<bhv::condition>("case 0", [] { return true; })
+        .handler<bhv::action>("handler 0", [] { return bhv::status::running; }, [&halted] { ++halted; })
+      .case_<bhv::condition>("case 1", [] { return true; })
+        .handler<bhv::action>("handler 1", [&] {
+          if (exception)
+            throw 42;
+          return bhv::status::running;
+        });
+  // clang-format on
+
+  bhv::flat_tree const tree(switch_);
+  bhv::batch runner(tree, 3);
+
+  REQUIRE(runner()[2] == bhv::status::running);
+  exception = true;
+  REQUIRE_THROWS(runner());
+  REQUIRE(halted == 3);
+}
+
+TEST_CASE("Halting batch instances", "[halt]") {
+  int halted = 0;
+  std::vector<size_t> bound_halted;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 2)
+        .add<bhv::action>("1", [] { return bhv::status::running; }, [&halted] { ++halted; })
+        .add(bhv::if_("if", bhv::condition("cond", [] { return true; }))
+             .then_<bhv::action>("2", [] { return bhv::status::running; }, [&halted] { halted += 10; }));
+  // clang-format on
+
+  bhv::flat_tree const tree(par);
+  bhv::batch runner(tree, 3);
+  runner.bind(
+      "2",
+      [](bhv::agents const &active, bhv::status *results) {
+        std::fill(results, results + active.size(), bhv::status::running);
+      },
+      [&bound_halted](size_t agent) { bound_halted.push_back(agent); });
+
+  std::vector<size_t> const running = {0, 2};
+  std::vector<size_t> const idle = {1};
+  bhv::status results[2];
+  runner(bhv::agents(running), results);
+  REQUIRE(results[0] == bhv::status::running);
+
+  // The idle instance has nothing to halt
+  runner.halt(bhv::agents(idle));
+  REQUIRE(halted == 0);
+  REQUIRE(bound_halted.empty());
+
+  // The bound action is halted by the batch halt handler
+  runner.halt(bhv::agents(running));
+  REQUIRE(halted == 2);
+  REQUIRE(bound_halted == running);
+
+  runner.halt();
+  REQUIRE(halted == 2);
+
+  std::vector<size_t> const invalid = {3};
+  REQUIRE_THROWS(runner.halt(bhv::agents(invalid)));
+}
+
+TEST_CASE("Parallel doesn't tick the children after the outcome is decided",
+          "[halt]") {
+  int entered = 0, halted = 0;
+
+  // clang-format off
+  auto par =
+      bhv::parallel("root", 1)
+        .add<bhv::action>("1", [] { return bhv::status::success; })
+        .add<bhv::action>("2", [&entered] { ++entered; return bhv::status::running; }, [&halted] { ++halted; });
+  // clang-format on
+
+  REQUIRE(par() == bhv::status::success);
+
+  bhv::flat_tree const tree(par);
+  auto st = tree.make_state();
+  REQUIRE(tree(st) == bhv::status::success);
+
+  bhv::batch runner(tree, 4);
+  REQUIRE(runner()[3] == bhv::status::success);
+
+  auto fixed = bhv::fixed::parallel(
+      "root", 1, bhv::fixed::action("1", [] { return bhv::status::success; }),
+      bhv::fixed::action(
+          "2",
+          [&entered] {
+            ++entered;
+            return bhv::status::running;
+          },
+          [&halted] { ++halted; }));
+  REQUIRE(fixed() == bhv::status::success);
+
+  REQUIRE(entered == 0);
+  REQUIRE(halted == 0);
+}
@@ -0,0 +1,84 @@
+#include "catch.hpp"
+#include <bhvimage.hpp>
+#include <bhvserializer.hpp>
+#include <bhvtree.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace cppttl;
+
+namespace {
+
+bool inside(std::string_view name, char const *data, size_t size) {
+  return name.data() >= data && name.data() + name.size() <= data + size;
+}
+
+} // namespace
+
+TEST_CASE("Tree is loaded from the binary image in place", "[image]") {
+  int n = 0;
+
+  bhv::registry reg;
+  reg.action("step", [&n] { ++n; return bhv::status::success; });
+
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add<bhv::action>("step", [] { return bhv::status::failure; })
+        .add(bhv::repeat("repeat", 2).child<bhv::action>("step", [] { return bhv::status::failure; }));
+  // clang-format on
+
+  std::stringstream ss;
+  bhv::save(ss, root, bhv::format::binary);
+  auto const data = ss.str();
+
+  auto loaded = bhv::load(std::string_view(data), reg);
+
+  REQUIRE((*loaded)() == bhv::status::success);
+  REQUIRE(n == 3);
+  REQUIRE(inside(loaded->name(), data.data(), data.size()));
+
+  auto const &childs = static_cast<bhv::sequence const &>(*loaded).childs();
+  REQUIRE(inside(childs.front()->name(), data.data(), data.size()));
+
+  REQUIRE_THROWS(bhv::load(std::string_view(data).substr(0, 10), reg));
+}
+
+TEST_CASE("Tree is loaded from the mapped image file", "[image]") {
+  auto const path =
+      (std::filesystem::temp_directory_path() / "bhvtree-image-test.bin")
+          .string();
+
+  bhv::registry reg;
+  reg.condition("ready", [] { return true; });
+
+  {
+    std::ofstream file(path, std::ios::binary);
+    auto root = bhv::invert("root").child<bhv::condition>("ready", [] {
+      return false;
+    });
+    bhv::save(file, root, bhv::format::binary);
+  }
+
+  bhv::node::ptr loaded;
+
+  {
+    bhv::image const img(path);
+    REQUIRE(img.size() != 0);
+
+    loaded = bhv::load(img, reg);
+    REQUIRE(inside(loaded->name(), img.data(), img.size()));
+  }
+
+  // The loaded tree keeps the mapping
+  REQUIRE(loaded->name() == "root");
+  REQUIRE((*loaded)() == bhv::status::failure);
+
+  loaded.reset();
+  std::remove(path.c_str());
+
+  REQUIRE_THROWS(bhv::image(path));
+}
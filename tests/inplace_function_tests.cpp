@@ -0,0 +1,89 @@
+#include "catch.hpp"
+#include <bhvtree.hpp>
+#include <functional>
+#include <memory>
+
+using namespace cppttl;
+
+namespace {
+
+struct counter {
+  int *alive;
+
+  counter(int *n) : alive(n) { ++*alive; }
+  counter(counter &&other) noexcept : alive(other.alive) { ++*alive; }
+  ~counter() { --*alive; }
+
+  int operator()(int x) const { return x * 2; }
+};
+
+bhv::status step(void *context) {
+  return ++*static_cast<int *>(context) < 2 ? bhv::status::running
+                                            : bhv::status::success;
+}
+
+bool is_positive(void *context) { return *static_cast<int *>(context) > 0; }
+
+} // namespace
+
+TEST_CASE("Inplace function lifetime", "[inplace_function]") {
+  int alive = 0;
+
+  {
+    bhv::inplace_function<int(int)> fn = counter(&alive);
+    REQUIRE(alive == 1);
+    REQUIRE(fn(21) == 42);
+
+    auto moved = std::move(fn);
+    REQUIRE(alive == 1);
+    REQUIRE(!fn);
+    REQUIRE(moved(2) == 4);
+
+    fn = std::move(moved);
+    REQUIRE(alive == 1);
+    REQUIRE(fn(3) == 6);
+
+    fn = nullptr;
+    REQUIRE(alive == 0);
+  }
+
+  REQUIRE(alive == 0);
+}
+
+TEST_CASE("Empty inplace function", "[inplace_function]") {
+  bhv::inplace_function<void()> fn;
+  REQUIRE(!fn);
+  REQUIRE_THROWS_AS(fn(), std::bad_function_call);
+}
+
+TEST_CASE("Function pointer with context", "[inplace_function]") {
+  int n = 0;
+
+  bhv::inplace_function<bhv::status()> fn(&step, &n);
+  REQUIRE(fn);
+  REQUIRE(fn() == bhv::status::running);
+  REQUIRE(fn() == bhv::status::success);
+
+  auto moved = std::move(fn);
+  REQUIRE(moved() == bhv::status::success);
+  REQUIRE(n == 3);
+}
+
+TEST_CASE("Leaves with move-only callables and contexts", "[inplace_function]") {
+  int n = 0;
+  auto value = std::make_unique<int>(1);
+
+  // clang-format off
+  auto seq =
+      bhv::sequence("root")
+        .add<bhv::condition>("positive", &is_positive, value.get())
+        .add<bhv::action>("step", &step, &n)
+        .add<bhv::action>("unique", [p = std::move(value)] {
+          return *p > 0 ? bhv::status::success : bhv::status::failure;
+        });
+  // clang-format on
+
+  REQUIRE(seq() == bhv::status::running);
+  REQUIRE(seq() == bhv::status::success);
+  REQUIRE(n == 2);
+}
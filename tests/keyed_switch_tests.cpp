@@ -0,0 +1,138 @@
+#include "catch.hpp"
+#include <bhvflat.hpp>
+#include <bhvserializer.hpp>
+#include <bhvtree.hpp>
+#include <sstream>
+
+using namespace cppttl;
+
+namespace {
+
+enum class mode { idle, walk, run, jump = 1000 };
+
+} // namespace
+
+TEST_CASE("Keyed switch dispatches to the handler of the key", "[keyed_switch]") {
+  mode m = mode::idle;
+  int keys = 0, idle = 0, move = 0, jump = 0, other = 0;
+
+  // clang-format off
+  auto root =
+      bhv::switch_("switch", [&] { ++keys; return m; })
+        .case_(mode::idle)
+          .handler<bhv::action>("idle", [&] { ++idle; return bhv::status::success; })
+        .case_(mode::walk)
+        .case_(mode::run)
+          .handler<bhv::action>("move", [&] { return ++move % 2 ? bhv::status::running : bhv::status::success; })
+        .case_(mode::jump)
+          .handler<bhv::action>("jump", [&] { ++jump; return bhv::status::failure; })
+        .default_<bhv::action>("other", [&] { ++other; return bhv::status::success; });
+  // clang-format on
+
+  REQUIRE(root.keyed());
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((keys == 1 && idle == 1));
+
+  // The key isn't re-evaluated while the handler is running
+  m = mode::run;
+  REQUIRE(root() == bhv::status::running);
+  m = mode::idle;
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((keys == 2 && move == 2 && idle == 1));
+
+  m = mode::jump;
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE(jump == 1);
+
+  m = static_cast<mode>(42);
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(other == 1);
+}
+
+TEST_CASE("Keyed switch executes all the handlers of the value",
+          "[keyed_switch]") {
+  long long key = 0;
+  int h0 = 0, h1 = 0;
+
+  // Sparse keys are dispatched through the hash table
+  // clang-format off
+  auto root =
+      bhv::switch_("switch", [&key] { return key; })
+        .case_(-1000000)
+        .case_(7)
+        .case_(7)
+          .handler<bhv::action>("h0", [&h0] { ++h0; return bhv::status::success; })
+        .case_(7)
+        .case_(1LL << 40)
+          .handler<bhv::action>("h1", [&h1] { ++h1; return bhv::status::failure; });
+  // clang-format on
+
+  key = 7;
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE((h0 == 1 && h1 == 1));
+
+  key = -1000000;
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((h0 == 2 && h1 == 1));
+
+  key = 1LL << 40;
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE((h0 == 2 && h1 == 2));
+
+  // No matched case and no default handler
+  key = 8;
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE((h0 == 2 && h1 == 2));
+}
+
+TEST_CASE("Keyed switch after the exception", "[keyed_switch]") {
+  bool exception = true;
+  int n = 0;
+
+  // clang-format off
+  auto root =
+      bhv::switch_("switch", [&] { if (exception) throw 42; return 1; })
+        .case_(1)
+          .handler<bhv::action>("h", [&n] { ++n; return bhv::status::success; });
+  // clang-format on
+
+  REQUIRE_THROWS(root());
+  exception = false;
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(n == 1);
+
+  // The cases can't be mixed
+  auto keyed = bhv::switch_("keyed", [] { return 0; });
+  REQUIRE_THROWS(keyed.case_<bhv::condition>("c", [] { return true; }));
+  auto regular = bhv::switch_("regular");
+  REQUIRE_THROWS(regular.case_(0));
+}
+
+TEST_CASE("Keyed switch in flat trees and serializer", "[keyed_switch]") {
+  int key = 0, h0 = 0, h1 = 0;
+
+  // clang-format off
+  auto root =
+      bhv::switch_("switch", [&key] { return key; })
+        .case_(0)
+          .handler<bhv::action>("h0", [&h0] { ++h0; return bhv::status::success; })
+        .case_(1)
+          .handler<bhv::action>("h1", [&h1] { ++h1; return bhv::status::failure; });
+  // clang-format on
+
+  bhv::flat_tree const tree(root);
+  auto st = tree.make_state();
+
+  REQUIRE(tree(st) == bhv::status::success);
+  key = 1;
+  REQUIRE(tree(st) == bhv::status::failure);
+  REQUIRE((h0 == 1 && h1 == 1));
+
+  std::stringstream ss;
+  ss << root;
+  REQUIRE(ss.str() == "switch \"switch\":\n"
+                      "  - case: condition \"0\"\n"
+                      "    body: action \"h0\"\n"
+                      "  - case: condition \"1\"\n"
+                      "    body: action \"h1\"\n");
+}
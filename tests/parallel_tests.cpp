@@ -16,7 +16,7 @@ TEST_CASE("Parallel node", "[parallel]") {
   // clang-format on
 
   REQUIRE(seq() == bhv::status::success);
-  REQUIRE(n == 4);
+  REQUIRE(n == 3); // The last child isn't ticked once the outcome is decided
 }
 
 TEST_CASE("Parallel failed node", "[parallel]") {
@@ -50,7 +50,7 @@ TEST_CASE("Running a parallel node with successful completion", "[parallel]") {
   REQUIRE(seq() == bhv::status::running);
   REQUIRE(n == 4);
   REQUIRE(seq() == bhv::status::success);
-  REQUIRE(n == 7);
+  REQUIRE(n == 6); // The last child isn't ticked once the outcome is decided
   REQUIRE(seq() == bhv::status::running);
   REQUIRE(n == 4);
 }
@@ -94,5 +94,5 @@ TEST_CASE("Running a parallel after the exception", "[parallel]") {
   REQUIRE_THROWS(seq());
   REQUIRE(n == 3);
   REQUIRE(seq() == bhv::status::success);
-  REQUIRE(n == 7);
+  REQUIRE(n == 6);
 }
@@ -0,0 +1,113 @@
+#include "catch.hpp"
+#include <bhvprofiler.hpp>
+#include <bhvtree.hpp>
+#include <thread>
+
+using namespace cppttl;
+
+namespace {
+
+bhv::node_profile find(bhv::profiler::profiles const &list,
+                       bhv::node const &ref) {
+  for (auto const &profile : list) {
+    if (profile.source == &ref)
+      return profile;
+  }
+  return {};
+}
+
+} // namespace
+
+#ifdef BHVT_PROFILING
+
+TEST_CASE("Profiler counts the node ticks and statuses", "[profiler]") {
+  int n = 0;
+
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add<bhv::condition>("ready", [] { return true; })
+        .add<bhv::action>("move", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::success; });
+  // clang-format on
+
+  auto const &move = *root.childs().back();
+
+  bhv::profiler::reset();
+  for (int i = 0; i < 4; ++i)
+    root();
+
+  auto const list = bhv::profiler::snapshot();
+
+  auto const seq = find(list, root);
+  REQUIRE(seq.name == "root");
+  REQUIRE(seq.type == bhv::node_type::sequence);
+  REQUIRE(seq.ticks == 4);
+  REQUIRE(seq.count(bhv::status::running) == 2);
+  REQUIRE(seq.count(bhv::status::success) == 2);
+
+  auto const action = find(list, move);
+  REQUIRE(action.name == "move");
+  REQUIRE(action.ticks == 4);
+  REQUIRE(action.count(bhv::status::running) == 2);
+  REQUIRE(action.count(bhv::status::failure) == 0);
+
+  // The time of the control node includes the children
+  REQUIRE(seq.total_time >= action.total_time);
+  REQUIRE(action.max_time <= action.total_time);
+
+  bhv::profiler::reset();
+  REQUIRE(find(bhv::profiler::snapshot(), root).ticks == 0);
+}
+
+TEST_CASE("Profiler merges the threads", "[profiler]") {
+  auto root = bhv::invert("root").child<bhv::action>("fail", [] {
+    return bhv::status::failure;
+  });
+
+  bhv::profiler::reset();
+
+  std::thread worker([&] {
+    for (int i = 0; i < 3; ++i)
+      root();
+  });
+  worker.join();
+
+  root();
+  REQUIRE_THROWS(bhv::action("throw", []() -> bhv::status { throw 42; })());
+
+  auto const profile = find(bhv::profiler::snapshot(), root);
+  REQUIRE(profile.ticks == 4);
+  REQUIRE(profile.count(bhv::status::success) == 4);
+}
+
+TEST_CASE("Profiler ignores the invalid statuses", "[profiler]") {
+  static size_t const invalid_status = 42;
+  static bhv::status const *pstatus =
+      reinterpret_cast<bhv::status const *>(&invalid_status);
+
+  auto inv = bhv::invert("inv").child<bhv::action>("a", [] {
+    return *pstatus;
+  });
+  auto const &child = *inv.childs().front();
+
+  bhv::profiler::reset();
+  REQUIRE_THROWS(inv());
+
+  auto const list = bhv::profiler::snapshot();
+  auto const action = find(list, child);
+  REQUIRE(action.ticks == 1);
+  REQUIRE(action.errors() == 1);
+  REQUIRE(find(list, inv).errors() == 1);
+}
+
+#else
+
+TEST_CASE("Profiler is compiled out", "[profiler]") {
+  auto root = bhv::action("a", [] { return bhv::status::success; });
+  root();
+
+  REQUIRE(!bhv::profiler::enabled);
+  REQUIRE(find(bhv::profiler::snapshot(), root).ticks == 0);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "catch.hpp"
+#include <bhvflat.hpp>
+#include <bhvserializer.hpp>
+#include <bhvtree.hpp>
+#include <sstream>
+#include <utility>
+
+using namespace cppttl;
+
+TEST_CASE("Reactive node re-evaluates the subtree on input changes",
+          "[reactive]") {
+  bhv::value<int> distance(10);
+  bhv::input alarm;
+  int checks = 0, n = 0;
+
+  // clang-format off
+  auto root =
+      bhv::reactive("reactive")
+        .child(bhv::sequence("seq")
+               .add<bhv::condition>("near", [&] { ++checks; return distance.get() < 5; }, distance, alarm)
+               .add<bhv::action>("attack", [&n] { ++n; return bhv::status::success; }));
+  // clang-format on
+
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE(checks == 1);
+
+  // The same value doesn't change the input
+  distance.set(10);
+  REQUIRE(root() == bhv::status::failure);
+  REQUIRE(checks == 1);
+
+  distance.set(3);
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((checks == 2 && n == 1));
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((checks == 2 && n == 1));
+
+  alarm.notify();
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE((checks == 3 && n == 2));
+}
+
+TEST_CASE("Running reactive subtree is ticked every time", "[reactive]") {
+  bhv::input in;
+  int n = 0;
+
+  // clang-format off
+  auto root =
+      bhv::reactive("reactive")
+        .child(bhv::sequence("seq")
+               .add<bhv::condition>("c", [] { return true; }, in)
+               .add<bhv::action>("a", [&n] { return ++n < 3 ? bhv::status::running : bhv::status::success; }));
+  // clang-format on
+
+  REQUIRE(root() == bhv::status::running);
+  REQUIRE(root() == bhv::status::running);
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(n == 3);
+}
+
+TEST_CASE("Reactive node after the exception and halt", "[reactive]") {
+  bool exception = true;
+  int n = 0;
+
+  auto root = bhv::reactive("reactive").child<bhv::action>("a", [&] {
+    ++n;
+    if (std::exchange(exception, false))
+      throw 42;
+    return n < 3 ? bhv::status::running : bhv::status::success;
+  });
+
+  REQUIRE_THROWS(root());
+  REQUIRE(root() == bhv::status::running);
+  root.halt();
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(root() == bhv::status::success);
+  REQUIRE(n == 3);
+
+  auto empty = bhv::reactive("empty");
+  REQUIRE_THROWS(empty());
+}
+
+TEST_CASE("Reactive node in flat trees and serializer", "[reactive]") {
+  int n = 0;
+
+  auto root = bhv::reactive("reactive").child<bhv::action>("a", [&n] {
+    ++n;
+    return bhv::status::success;
+  });
+
+  bhv::flat_tree const tree(root);
+  auto st = tree.make_state();
+
+  // The flat tree evaluates the child on every tick
+  REQUIRE(tree.records().size() == 1);
+  REQUIRE(tree(st) == bhv::status::success);
+  REQUIRE(tree(st) == bhv::status::success);
+  REQUIRE(n == 2);
+
+  std::stringstream ss;
+  ss << root;
+  REQUIRE(ss.str() == "reactive \"reactive\": action \"a\"\n");
+}
@@ -0,0 +1,301 @@
+#include "catch.hpp"
+#include <bhvexecutor.hpp>
+#include <bhvflat.hpp>
+#include <bhvscheduler.hpp>
+#include <bhvtree.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <vector>
+
+using namespace cppttl;
+
+namespace {
+
+struct instance_state {
+  std::atomic<bool> ticking{};
+  int ticks = 0;
+  bool raced = false;
+};
+
+} // namespace
+
+TEST_CASE("Scheduler ticks every instance once per frame", "[scheduler]") {
+  bhv::thread_pool pool(4);
+  bhv::scheduler sched(pool, 16);
+
+  std::vector<instance_state> states(1000);
+  for (auto &state : states) {
+    sched.add(bhv::make_node<bhv::action>("a", [&state] {
+      state.raced |= state.ticking.exchange(true);
+      ++state.ticks;
+      state.ticking = false;
+      return state.ticks % 3 ? bhv::status::running : bhv::status::success;
+    }));
+  }
+
+  std::vector<size_t> frames;
+  sched.on_frame([&frames](size_t frame) { frames.push_back(frame); });
+
+  for (int i = 0; i < 10; ++i)
+    sched.tick();
+
+  REQUIRE(sched.size() == 1000);
+  REQUIRE(sched.frames() == 10);
+  REQUIRE(frames == std::vector<size_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+  for (auto const &state : states) {
+    REQUIRE(state.ticks == 10);
+    REQUIRE(!state.raced);
+  }
+  REQUIRE(sched.last(0) == bhv::status::running);
+}
+
+TEST_CASE("Scheduler runs the flat tree instances", "[scheduler]") {
+  bhv::thread_pool pool(2);
+
+  std::atomic<int> n{0};
+  int halted = 0;
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add<bhv::condition>("ready", [] { return true; })
+        .add<bhv::action>("move", [&n] { ++n; return bhv::status::running; },
+                                  [&halted] { ++halted; });
+  // clang-format on
+  bhv::flat_tree const tree(root);
+
+  bhv::scheduler sched(pool, 1);
+  auto const a = sched.add(tree);
+  auto const b = sched.add(tree);
+
+  sched.tick();
+  REQUIRE(n == 2);
+  REQUIRE(sched.last(a) == bhv::status::running);
+
+  sched.remove(a);
+  REQUIRE(halted == 1);
+  REQUIRE(sched.size() == 1);
+  REQUIRE_THROWS(sched.last(a));
+  REQUIRE_THROWS(sched.remove(a));
+
+  // The removed slot is reused
+  REQUIRE(sched.add(tree) == a);
+  sched.tick();
+  REQUIRE(n == 4);
+  REQUIRE(sched.last(b) == bhv::status::running);
+}
+
+TEST_CASE("Scheduler completes the frame after the exception", "[scheduler]") {
+  bhv::thread_pool pool(2);
+  bhv::scheduler sched(pool, 2);
+
+  std::atomic<int> n{0};
+  for (int i = 0; i < 5; ++i) {
+    sched.add(bhv::make_node<bhv::action>("a", [&n, i]() -> bhv::status {
+      if (i == 2)
+        throw 42;
+      ++n;
+      return bhv::status::success;
+    }));
+  }
+
+  REQUIRE_THROWS_AS(sched.tick(), int);
+  REQUIRE(n == 4);
+  REQUIRE(sched.last(2) == bhv::status::failure);
+  REQUIRE(sched.last(3) == bhv::status::success);
+  REQUIRE(sched.frames() == 1);
+}
+
+TEST_CASE("Scheduler runs the frames at the target frequency",
+          "[scheduler]") {
+  using namespace std::chrono;
+
+  bhv::thread_pool pool(1);
+  bhv::scheduler sched(pool);
+  sched.add(bhv::make_node<bhv::action>("a", [] {
+    return bhv::status::success;
+  }));
+
+  auto const start = steady_clock::now();
+  sched.run(milliseconds(2), 5);
+  REQUIRE(sched.frames() == 5);
+  REQUIRE(steady_clock::now() - start >= milliseconds(8));
+
+  sched.on_frame([&sched](size_t frame) {
+    if (frame == 8)
+      sched.stop();
+  });
+  sched.run(milliseconds(1));
+  REQUIRE(sched.frames() == 8);
+}
+
+TEST_CASE("Scheduler stop requests aren't lost", "[scheduler]") {
+  using namespace std::chrono;
+
+  bhv::thread_pool pool(1);
+  bhv::scheduler sched(pool);
+  sched.add(bhv::make_node<bhv::action>("a", [] {
+    return bhv::status::success;
+  }));
+
+  SECTION("Stop from the frame handler") {
+    sched.on_frame([&sched](size_t) { sched.stop(); });
+    sched.run(milliseconds(1));
+    REQUIRE(sched.frames() == 1);
+
+    // The request is consumed by the loop
+    sched.on_frame({});
+    sched.run(milliseconds(1), 2);
+    REQUIRE(sched.frames() == 3);
+  }
+
+  SECTION("Stop before the run") {
+    sched.stop();
+    sched.run(milliseconds(1));
+    REQUIRE(sched.frames() == 0);
+
+    sched.run(milliseconds(1), 2);
+    REQUIRE(sched.frames() == 2);
+  }
+}
+
+TEST_CASE("Scheduler spreads the instances over their periods",
+          "[scheduler]") {
+  bhv::thread_pool pool(2);
+  bhv::scheduler sched(pool, 1);
+
+  std::atomic<int> ticks{0};
+  auto make = [&ticks] {
+    return bhv::make_node<bhv::action>("a", [&ticks] {
+      ++ticks;
+      return bhv::status::success;
+    });
+  };
+
+  sched.add(make());
+  for (int i = 0; i < 4; ++i)
+    sched.add(make(), 4);
+
+  std::vector<int> frames;
+  sched.on_frame([&](size_t) { frames.push_back(ticks.exchange(0)); });
+
+  for (int i = 0; i < 8; ++i)
+    sched.tick();
+
+  // The full rate instance and one of the instances with the period 4
+  REQUIRE(frames == std::vector<int>(8, 2));
+  REQUIRE(sched.period(1) == 4);
+
+  // The promoted instance is ticked every frame
+  sched.set_period(1, 1);
+  sched.tick();
+  sched.tick();
+  REQUIRE(frames[8] + frames[9] == 5);
+}
+
+TEST_CASE("Scheduler limits the work of the frame", "[scheduler]") {
+  bhv::thread_pool pool(2);
+  bhv::scheduler sched(pool, 4);
+
+  std::vector<int> ticks(10);
+  for (auto &n : ticks) {
+    sched.add(bhv::make_node<bhv::action>("a", [&n] {
+                ++n;
+                return bhv::status::success;
+              }),
+              2);
+  }
+
+  sched.set_frame_limit(3);
+
+  int total = 0;
+  for (int i = 0; i < 20; ++i) {
+    sched.tick();
+    int const sum = std::accumulate(ticks.begin(), ticks.end(), 0);
+    REQUIRE(sum - total <= 3);
+    total = sum;
+  }
+
+  // The instances left over aren't starved
+  REQUIRE(total == 60);
+  REQUIRE(*std::min_element(ticks.begin(), ticks.end()) >= 5);
+}
+
+TEST_CASE("Scheduler promotes and demotes the instances", "[scheduler]") {
+  bhv::thread_pool pool(1);
+  bhv::scheduler sched(pool);
+
+  int n = 0;
+  bool busy = false;
+  auto const id = sched.add(bhv::make_node<bhv::action>("a", [&] {
+    ++n;
+    return busy ? bhv::status::running : bhv::status::success;
+  }));
+
+  // The idle instance is demoted, the busy one is promoted
+  sched.on_lod([](bhv::scheduler::instance, bhv::status st, size_t) -> size_t {
+    return st == bhv::status::running ? 1 : 3;
+  });
+
+  for (int i = 0; i < 7; ++i)
+    sched.tick();
+  REQUIRE(n == 3); // frames 1, 4, 7
+  REQUIRE(sched.period(id) == 3);
+
+  busy = true;
+  for (int i = 0; i < 6; ++i)
+    sched.tick();
+  REQUIRE(n == 7); // frames 10, 11, 12, 13
+  REQUIRE(sched.period(id) == 1);
+
+  sched.remove(id);
+  for (int i = 0; i < 6; ++i)
+    sched.tick();
+  REQUIRE(n == 7);
+}
+
+TEST_CASE("Scheduler keeps the instances ticked every frame", "[scheduler]") {
+  bhv::thread_pool pool(2);
+  bhv::scheduler sched(pool, 2);
+
+  std::vector<std::atomic<int>> ticks(6);
+  std::vector<bhv::scheduler::instance> ids;
+  for (auto &n : ticks) {
+    ids.push_back(sched.add(bhv::make_node<bhv::action>("a", [&n] {
+      ++n;
+      return bhv::status::running;
+    })));
+  }
+
+  auto ticked = [&ticks] {
+    std::vector<int> result;
+    for (auto &n : ticks)
+      result.push_back(n.exchange(0));
+    return result;
+  };
+
+  sched.tick();
+  REQUIRE(ticked() == std::vector<int>{1, 1, 1, 1, 1, 1});
+
+  // The removed and demoted instances leave the list, the promoted ones
+  // return to it
+  sched.remove(ids[1]);
+  sched.set_period(ids[0], 10);
+  sched.set_period(ids[4], 10);
+  sched.set_period(ids[4], 1);
+  sched.set_period(ids[5], 1);
+  sched.tick();
+  REQUIRE(ticked() == std::vector<int>{0, 0, 1, 1, 1, 1});
+
+  // The slot of the removed instance is reused
+  auto const id = sched.add(bhv::make_node<bhv::action>("b", [&ticks] {
+    ++ticks[1];
+    return bhv::status::running;
+  }));
+  REQUIRE(id == ids[1]);
+  sched.set_period(ids[0], 1);
+  sched.remove(ids[3]);
+  sched.tick();
+  REQUIRE(ticked() == std::vector<int>{1, 1, 1, 0, 1, 1});
+}
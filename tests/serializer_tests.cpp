@@ -1,7 +1,10 @@
+#include "allocations.hpp"
 #include "bhvtree.hpp"
 #include "catch.hpp"
 #include <bhvserializer.hpp>
 #include <sstream>
+#include <string>
+#include <vector>
 
 using namespace cppttl;
 
@@ -212,3 +215,37 @@ TEST_CASE("Force node serialization", "[serializer]") {
   ss << force_success;
   ss << force_failure;
 }
+
+TEST_CASE("Serialization into the buffer", "[serializer]") {
+  auto success = [] { return bhv::status::success; };
+
+  // The node names are not owned by the nodes
+  std::vector<std::string> names;
+  for (int i = 0; i < 10; ++i)
+    names.emplace_back("fallback \"" + std::to_string(i) + "\"");
+
+  auto root = bhv::sequence("root");
+  for (int i = 0; i < 2000; ++i) {
+    // clang-format off
+    root.add(bhv::fallback(names[i % names.size()])
+             .add<bhv::condition>("ready", [] { return true; })
+             .add(bhv::repeat("repeat", 3).child<bhv::action>("move", success)));
+    // clang-format on
+  }
+
+  // The stream is written in blocks
+  std::stringstream ss;
+  ss << root;
+
+  std::string buffer;
+  bhv::save(buffer, root, bhv::format::text);
+  REQUIRE(buffer == ss.str());
+  REQUIRE(buffer.size() > 100000);
+
+  // The reused buffer isn't reallocated
+  buffer.clear();
+  size_t const before = test::allocations();
+  bhv::save(buffer, root, bhv::format::text);
+  REQUIRE(test::allocations() == before);
+  REQUIRE(buffer == ss.str());
+}
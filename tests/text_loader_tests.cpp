@@ -0,0 +1,163 @@
+#include "catch.hpp"
+#include <bhvserializer.hpp>
+#include <bhvtree.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace cppttl;
+
+namespace {
+
+std::string to_text(bhv::node const &ref) {
+  std::stringstream ss;
+  ss << ref;
+  return ss.str();
+}
+
+bhv::node::ptr from_text(std::string const &text, bhv::registry const &reg) {
+  std::stringstream ss(text);
+  return bhv::load(ss, reg, bhv::format::text);
+}
+
+} // namespace
+
+TEST_CASE("Text loader reads the serializer output", "[text]") {
+  int key = 0;
+  auto success = [] { return bhv::status::success; };
+  auto yes = [] { return true; };
+
+  bhv::registry reg;
+  reg.action("a", success).condition("c", yes).key("keyed", [&key] { return key; });
+
+  // clang-format off
+  auto root =
+      bhv::sequence("root")
+        .add(bhv::parallel("par", 2)
+             .add<bhv::action>("a", success)
+             .add(bhv::invert("inv")
+                  .child(bhv::repeat("repeat", 2)
+                         .child(bhv::fallback("fal")
+                                .add<bhv::condition>("c", yes)
+                                .add<bhv::action>("a", success))))
+             .add<bhv::action>("a", success))
+        .add(bhv::if_("if", bhv::condition("c", yes))
+             .then_(bhv::sequence("then")
+                    .add<bhv::action>("a", success))
+             .else_(bhv::retry("retry").child<bhv::action>("a", success)))
+        .add(bhv::if_("empty if"))
+        .add(bhv::switch_("switch")
+             .case_<bhv::condition>("c", yes)
+             .case_(bhv::sequence("seq case").add<bhv::condition>("c", yes))
+               .handler<bhv::action>("a", success)
+             .case_<bhv::condition>("c", yes)
+               .handler(bhv::force("force", bhv::status::failure))
+             .default_<bhv::action>("a", success))
+        .add(bhv::switch_("keyed", [&key] { return key; })
+             .case_(-5)
+             .case_(7)
+               .handler<bhv::action>("a", success)
+             .case_(8)
+               .handler(bhv::reactive("reactive").child<bhv::condition>("c", yes)))
+        .add(bhv::switch_("empty switch"))
+        .add(bhv::invert("empty invert"))
+        .add(bhv::sequence("\"quoted\" name"));
+  // clang-format on
+
+  auto const text = to_text(root);
+  auto loaded = from_text(text, reg);
+
+  REQUIRE(loaded);
+  REQUIRE(to_text(*loaded) == text);
+}
+
+TEST_CASE("Text loader binds the leaves to the registry", "[text]") {
+  int n = 0;
+  bool ready = false;
+
+  bhv::registry reg;
+  reg.action("step", [&n] { ++n; return bhv::status::success; })
+     .condition("ready", [&ready] { return ready; });
+
+  // Blank lines and Windows line endings are accepted
+  auto loaded = from_text("fallback \"root\":\r\n"
+                          "\n"
+                          "  - condition \"ready\"\r\n"
+                          "  - invert \"inv\": action \"step\"\r\n",
+                          reg);
+
+  REQUIRE((*loaded)() == bhv::status::failure);
+  REQUIRE(n == 1);
+  ready = true;
+  REQUIRE((*loaded)() == bhv::status::success);
+  REQUIRE(n == 1);
+}
+
+TEST_CASE("Text loader reports the invalid lines", "[text]") {
+  bhv::registry reg;
+  reg.action("a", [] { return bhv::status::success; });
+
+  auto error = [&reg](std::string const &text) -> std::string {
+    try {
+      from_text(text, reg);
+    } catch (std::runtime_error const &e) {
+      return e.what();
+    }
+    return {};
+  };
+
+  REQUIRE(error("sequence \"s\":\n  - action \"a\"\n  - loop \"l\"\n") ==
+          "Unknown node type at line 3");
+  REQUIRE(error("sequence \"s\":\n   - action \"a\"\n") ==
+          "Invalid indentation at line 2");
+  REQUIRE(error("sequence \"s\":\n    - action \"a\"\n") ==
+          "Unexpected node at line 2");
+  REQUIRE(error("repeat n=x \"r\": none\n") == "Invalid number at line 1");
+  REQUIRE(error("action \"a\n") == "Unterminated name at line 1");
+  REQUIRE(!error("action \"b\"\n").empty());
+  REQUIRE(!error("").empty());
+}
+
+TEST_CASE("Text loader reads large trees", "[text]") {
+  bhv::registry reg;
+  reg.action("a", [] { return bhv::status::success; });
+
+  std::string text = "sequence \"root\":\n";
+  for (int i = 0; i < 10000; ++i) {
+    text += "  - fallback \"f" + std::to_string(i) + "\":\n";
+    text += "    - action \"a\"\n";
+    text += "    - repeat n=2 \"r\": action \"a\"\n";
+  }
+
+  auto loaded = from_text(text, reg);
+
+  REQUIRE(to_text(*loaded) == text);
+  REQUIRE((*loaded)() == bhv::status::success);
+}
+
+TEST_CASE("Text loader rejects deeply nested trees", "[text]") {
+  bhv::registry reg;
+
+  // The decorators continue the line of their child
+  auto chain = [](size_t depth) {
+    std::string text;
+    for (size_t i = 0; i < depth; ++i)
+      text += "invert \"i\": ";
+    return text + "none\n";
+  };
+
+  auto nested = [](size_t depth) {
+    std::string text;
+    for (size_t i = 0; i < depth; ++i)
+      text += std::string(i * 2, ' ') + (i ? "- " : "") + "sequence \"s\":\n";
+    return text;
+  };
+
+  REQUIRE(from_text(chain(bhv::max_load_depth), reg));
+  REQUIRE(from_text(nested(bhv::max_load_depth), reg));
+  REQUIRE_THROWS_AS(from_text(chain(bhv::max_load_depth + 1), reg),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(from_text(nested(bhv::max_load_depth + 1), reg),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(from_text(chain(1000000), reg), std::runtime_error);
+}
@@ -0,0 +1,140 @@
+#include "catch.hpp"
+#include <bhvtrace.hpp>
+#include <bhvtree.hpp>
+#include <cstdint>
+#include <sstream>
+#include <thread>
+
+using namespace cppttl;
+
+namespace {
+
+std::uint64_t id(bhv::node const &ref) {
+  return reinterpret_cast<std::uintptr_t>(&ref);
+}
+
+} // namespace
+
+#ifdef BHVT_TRACING
+
+TEST_CASE("Trace records the node ticks", "[trace]") {
+  // clang-format off
+  auto root =
+      bhv::fallback("root")
+        .add<bhv::condition>("ready", [] { return false; })
+        .add<bhv::action>("move", [] { return bhv::status::running; });
+  // clang-format on
+
+  auto const &ready = *root.childs().front();
+  auto const &move = *root.childs().back();
+
+  std::stringstream ss;
+  bhv::trace::writer out(ss);
+  out.describe(root);
+
+  bhv::trace::start();
+  root();
+  bhv::trace::stop();
+  root();
+
+  REQUIRE(out.drain() == 6);
+  REQUIRE(out.drain() == 0);
+
+  auto const trace = bhv::trace::read(ss);
+
+  REQUIRE(trace.nodes.size() == 3);
+  REQUIRE(trace.nodes[0].node == id(root));
+  REQUIRE(trace.nodes[0].type == bhv::node_type::fallback);
+  REQUIRE(trace.nodes[0].name == "root");
+  REQUIRE(trace.nodes[2].name == "move");
+
+  auto const &events = trace.events;
+  REQUIRE(events.size() == 6);
+  REQUIRE((events[0].node == id(root) && events[0].what == bhv::trace::kind::enter));
+  REQUIRE((events[1].node == id(ready) && events[1].what == bhv::trace::kind::enter));
+  REQUIRE((events[2].node == id(ready) && events[2].result == bhv::status::failure));
+  REQUIRE((events[3].node == id(move) && events[3].what == bhv::trace::kind::enter));
+  REQUIRE((events[4].node == id(move) && events[4].result == bhv::status::running));
+  REQUIRE((events[5].node == id(root) && events[5].what == bhv::trace::kind::exit));
+  REQUIRE(events[5].result == bhv::status::running);
+  REQUIRE(events[0].time <= events[5].time);
+  REQUIRE(trace.dropped == 0);
+}
+
+TEST_CASE("Trace drops the events of the full buffer", "[trace]") {
+  auto root = bhv::action("a", []() -> bhv::status { throw 42; });
+
+  std::stringstream ss;
+  bhv::trace::writer out(ss);
+
+  bhv::trace::set_capacity(3);
+  bhv::trace::start();
+  std::thread worker([&root] {
+    for (int i = 0; i < 5; ++i)
+      REQUIRE_THROWS(root());
+  });
+  worker.join();
+  bhv::trace::stop();
+  bhv::trace::set_capacity(bhv::trace::default_capacity);
+
+  REQUIRE(out.drain() == 4);
+
+  auto const trace = bhv::trace::read(ss);
+  REQUIRE(trace.events.size() == 4);
+  REQUIRE(trace.events[1].what == bhv::trace::kind::exception);
+  REQUIRE(trace.dropped == 6);
+}
+
+TEST_CASE("Trace keeps the invalid statuses", "[trace]") {
+  auto root = bhv::action("a", [] { return static_cast<bhv::status>(42); });
+
+  std::stringstream ss;
+  bhv::trace::writer out(ss);
+  out.describe(root);
+
+  bhv::trace::start();
+  root();
+  bhv::trace::stop();
+
+  REQUIRE(out.drain() == 2);
+
+  auto const trace = bhv::trace::read(ss);
+  REQUIRE(trace.events.size() == 2);
+  REQUIRE(trace.events[1].what == bhv::trace::kind::exit);
+  REQUIRE(static_cast<int>(trace.events[1].result) == 42);
+}
+
+TEST_CASE("Invalid trace file is rejected", "[trace]") {
+  std::stringstream ss;
+  bhv::trace::writer out(ss);
+  out.describe(bhv::action("a", [] { return bhv::status::success; }));
+
+  auto const data = ss.str();
+  for (size_t size = 0; size < data.size(); ++size) {
+    std::stringstream in(data.substr(0, size));
+    // The header alone is an empty trace
+    if (size == 5)
+      REQUIRE(bhv::trace::read(in).nodes.empty());
+    else
+      REQUIRE_THROWS(bhv::trace::read(in));
+  }
+
+  std::stringstream in(data + '\x7f');
+  REQUIRE_THROWS(bhv::trace::read(in));
+}
+
+#else
+
+TEST_CASE("Trace is compiled out", "[trace]") {
+  auto root = bhv::action("a", [] { return bhv::status::success; });
+
+  bhv::trace::start();
+  root();
+  bhv::trace::stop();
+
+  std::vector<bhv::trace::event> events;
+  REQUIRE(!bhv::trace::enabled);
+  REQUIRE(bhv::trace::drain(events) == 0);
+}
+
+#endif